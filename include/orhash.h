@@ -7,11 +7,18 @@
 #define INCLUDE_ORHASH_H
 
 #include <mhash.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
 
-#include "orhash_types.h"
 #include "orhash_constants.h"
+#include "orhash_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 int
 orhash_init (void     *buffer,
@@ -19,6 +26,35 @@ orhash_init (void     *buffer,
              size_t   block_size,
              orhash_t **hash);
 
+/* Create a hash for the range [offset, offset + length) of a file; a length
+   of 0 means up to the end of the file. In the pread modes, io_depth is the
+   number of asynchronous reads of ORHASH_FILE_READ_SIZE bytes kept in flight
+   while the data already read is hashed (0 selects the default). */
+int
+orhash_init_file (const char        *path,
+                  off_t             offset,
+                  size_t            length,
+                  size_t            block_size,
+                  orhash_io_mode_t  io_mode,
+                  int               io_depth,
+                  orhash_t          **hash);
+
+/* Create a hash that only stores block hashes for regions of region_blocks
+   blocks (0 selects the default) that were touched with orhash_sparse_touch()
+   and did not only contain zeros when hashed; the other regions are assumed
+   to only contain zeros. Meant for large, mostly unused reservations. */
+int
+orhash_init_sparse (void        *buffer,
+                    size_t      buffer_size,
+                    size_t      block_size,
+                    size_t      region_blocks,
+                    orhash_t    **hash);
+
+/* Declare that the range [offset, offset + length) may have been written, so
+   its regions are hashed by the next orhash_compute_hash() */
+int
+orhash_sparse_touch (orhash_t *hash, size_t offset, size_t length);
+
 int
 orhash_reinit (orhash_t *hash_in,
                void     *buffer,
@@ -28,16 +64,141 @@ orhash_reinit (orhash_t *hash_in,
 int
 orhash_fini (orhash_t **hash);
 
+/* Hash the buffer as an array of elem_type values where changes below the
+   tolerance are ignored; must be called before computing hashes. The block
+   size and buffer size must be multiples of the element size. */
+int
+orhash_set_tolerance (orhash_t              *hash,
+                      orhash_elem_type_t    elem_type,
+                      orhash_tol_mode_t     tol_mode,
+                      double                tolerance);
+
+/* Confirm blocks found clean with the fast hash using a strong hash (e.g.,
+   MHASH_MD5 or MHASH_SHA256) computed only for those blocks. The strong hashes
+   of the reference are computed by the next orhash_set_ref_hash(). */
+int
+orhash_set_strong_hash (orhash_t *hash, hashid algo);
+
+/* Let application threads keep writing the buffer while it is hashed. Writers
+   bracket their writes with orhash_write_begin() and orhash_write_end(); these
+   only update per-block atomic counters. Blocks written at any time during a
+   computation, from orhash_compute_hash_start() to orhash_compute_hash_wait()
+   in the background, are reported dirty. Only for hashes of buffers in memory
+   whose blocks were not shifted by orhash_reinit(). */
+int
+orhash_set_concurrent (orhash_t *hash, int enable);
+
+int
+orhash_write_begin (orhash_t *hash, size_t offset, size_t length);
+
+int
+orhash_write_end (orhash_t *hash, size_t offset, size_t length);
+
+/* Run orhash_compute_hash() in a background thread */
+int
+orhash_compute_hash_start (orhash_t *hash);
+
+int
+orhash_compute_hash_wait (orhash_t *hash);
+
 int
 orhash_set_ref_hash (orhash_t *hash);
 
+/* Hash buffers with a minimal cache footprint: while a block is hashed, the
+   data prefetch_distance bytes ahead (0 selects the default) is prefetched
+   with a non-temporal hint */
+int
+orhash_set_streaming (orhash_t *hash, int enable, size_t prefetch_distance);
+
 int
 orhash_compute_hash (orhash_t *orhash);
 
+/* Use the reference hashes of another hash with the same block layout, e.g.,
+   to compare a file against the reference of a buffer in memory */
+int
+orhash_import_ref_hash (orhash_t *hash, orhash_t *from);
+
+/* Count the dirty blocks and, if bitmap is not NULL, set the bit of each dirty
+   block in it; bitmap must hold ORHASH_BITMAP_WORDS(num_blocks) words. Bit i
+   is for block i of the buffer. */
+int
+orhash_get_dirty_blocks (orhash_t *hash, uint64_t *bitmap, size_t *num_dirty);
+
 int
 orhash_get_dirty_ratio (orhash_t *hash, double *ratio);
 
+/* Estimate how well each block compresses while it is hashed, sampling a
+   window of the block every sample_stride bytes (0 selects the default) */
+int
+orhash_set_cost_model (orhash_t *hash, int enable, size_t sample_stride);
+
+/* Predict the bytes written by a full and by an incremental checkpoint of the
+   blocks dirty with respect to the reference */
+int
+orhash_get_checkpoint_cost (orhash_t *hash, orhash_cost_t *cost);
+
+/* Keep the last capacity dirty ratios of a hash, globally and for
+   num_regions ranges of blocks, to model how fast the buffer gets dirty */
+int
+orhash_history_init (orhash_t           *hash,
+                     size_t             capacity,
+                     size_t             num_regions,
+                     orhash_history_t   **history);
+
+/* Sample the dirty blocks; elapsed is the time or number of iterations since
+   the reference was set */
+int
+orhash_history_record (orhash_history_t *history, double elapsed);
+
+/* Fit the dirty rate of each region to the samples */
+int
+orhash_history_fit (orhash_history_t *history);
+
+/* Dirty ratio expected elapsed after the reference */
+int
+orhash_history_predict (orhash_history_t *history, double elapsed, double *ratio);
+
+/* Interval between checkpoints minimizing the time lost to checkpointing and
+   to failures, given the incremental checkpoint expected at that interval;
+   ratio, if not NULL, is set to the dirty ratio expected then */
+int
+orhash_history_suggest_interval (orhash_history_t               *history,
+                                 const orhash_ckpt_params_t     *params,
+                                 double                         *interval,
+                                 double                         *ratio);
+
+int
+orhash_history_fini (orhash_history_t **history);
+
+/* Compare two arrays of num_blocks block hashes of digest_len bytes each;
+   returns the number of differing hashes and, if bitmap is not NULL, sets
+   their bit in it */
+size_t
+orhash_compare_digests (const unsigned char     *digests,
+                        const unsigned char     *ref_digests,
+                        size_t                  num_blocks,
+                        size_t                  digest_len,
+                        uint64_t                *bitmap);
+
+/* Find the blocks with identical content using the current block hashes.
+   Blocks with matching hashes are only reported as duplicates, or as zeros,
+   once their data confirms it; in the pread modes the blocks are read back
+   from the file and, without verify, their strong hashes are compared
+   instead of their data. */
+int
+orhash_dedup (orhash_t *hash, int verify, orhash_dedup_t **dedup);
+
+int
+orhash_dedup_get_ratio (orhash_dedup_t *dedup, double *ratio);
+
+int
+orhash_dedup_fini (orhash_dedup_t **dedup);
+
 void
 orhash_print (orhash_t *hash);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#ifndef INCLUDE_ORHASH_HPP
+#define INCLUDE_ORHASH_HPP
+
+/* C++17 front end of liborhash, header only */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "orhash.h"
+
+namespace orhash {
+
+/* Error reported by the C core, rc is one of the orhash_rc_t values */
+class error : public std::runtime_error
+{
+public:
+    error (const char *what, int rc)
+        : std::runtime_error (std::string (what) + " failed (rc: " + std::to_string (rc) + ")"),
+          rc_ (rc)
+    {
+    }
+
+    int rc () const noexcept { return rc_; }
+
+private:
+    int rc_;
+};
+
+namespace detail {
+
+inline void
+check (int rc, const char *what)
+{
+    if (rc != ORHASH_SUCCESS)
+        throw error (what, rc);
+}
+
+struct hash_deleter
+{
+    void operator() (orhash_t *h) const noexcept { orhash_fini (&h); }
+};
+
+} /* namespace detail */
+
+/* Owner of an orhash_t with runtime block size; the C API remains available
+   through get() for the features that are not wrapped. The buffer is only
+   read. */
+class hash
+{
+public:
+    hash (const void *buffer, std::size_t buffer_size, std::size_t block_size)
+    {
+        orhash_t *h = nullptr;
+
+        detail::check (orhash_init (const_cast<void*> (buffer), buffer_size, block_size, &h),
+                       "orhash_init()");
+        h_.reset (h);
+    }
+
+    template <class Container,
+              class = decltype (std::data (std::declval<const Container&> ()))>
+    hash (const Container &c, std::size_t block_size)
+        : hash (std::data (c), std::size (c) * sizeof (*std::data (c)), block_size)
+    {
+    }
+
+    hash (hash &&) noexcept = default;
+    hash &operator= (hash &&) noexcept = default;
+    hash (const hash &) = delete;
+    hash &operator= (const hash &) = delete;
+
+    void compute () { detail::check (orhash_compute_hash (h_.get ()), "orhash_compute_hash()"); }
+
+    void set_reference () { detail::check (orhash_set_ref_hash (h_.get ()), "orhash_set_ref_hash()"); }
+
+    double
+    dirty_ratio () const
+    {
+        double ratio;
+
+        detail::check (orhash_get_dirty_ratio (h_.get (), &ratio), "orhash_get_dirty_ratio()");
+        return ratio;
+    }
+
+    std::size_t
+    dirty_blocks (std::uint64_t *bitmap = nullptr) const
+    {
+        std::size_t n;
+
+        detail::check (orhash_get_dirty_blocks (h_.get (), bitmap, &n), "orhash_get_dirty_blocks()");
+        return n;
+    }
+
+    std::size_t num_blocks () const noexcept { return h_->num_blocks; }
+
+    orhash_t *get () const noexcept { return h_.get (); }
+
+private:
+    std::unique_ptr<orhash_t, detail::hash_deleter> h_;
+};
+
+/* Adler-32 with the block size known at compile time: the loops have constant
+   bounds so the compiler unrolls and vectorizes them. Digests are stored in
+   the byte order of the C core, so both compute the same block hashes. */
+struct adler32
+{
+    using digest_type = std::uint32_t;
+
+    static constexpr std::size_t digest_len = 4;
+
+    static constexpr std::uint32_t base = 65521;
+    static constexpr std::size_t   nmax = 5552;   /* Bytes before the sums may overflow */
+
+    template <std::size_t N>
+    static digest_type
+    hash (const unsigned char *p) noexcept
+    {
+        std::uint32_t a = 1;
+        std::uint32_t b = 0;
+
+        update<N> (p, a, b);
+        return (b << 16) | a;
+    }
+
+    /* Runtime size, for a last partial block */
+    static digest_type
+    hash (const unsigned char *p, std::size_t n) noexcept
+    {
+        std::uint32_t a = 1;
+        std::uint32_t b = 0;
+
+        while (n > 0)
+        {
+            std::size_t len = n < nmax ? n : nmax;
+
+            for (std::size_t i = 0; i < len; i++)
+            {
+                a += p[i];
+                b += a;
+            }
+            a %= base;
+            b %= base;
+            p += len;
+            n -= len;
+        }
+        return (b << 16) | a;
+    }
+
+    /* Big endian, as mhash stores it */
+    static void
+    store (digest_type d, unsigned char *out) noexcept
+    {
+        out[0] = static_cast<unsigned char> (d >> 24);
+        out[1] = static_cast<unsigned char> (d >> 16);
+        out[2] = static_cast<unsigned char> (d >> 8);
+        out[3] = static_cast<unsigned char> (d);
+    }
+
+private:
+    template <std::size_t N>
+    static void
+    update (const unsigned char *p, std::uint32_t &a, std::uint32_t &b) noexcept
+    {
+        if constexpr (N > nmax)
+        {
+            update<nmax> (p, a, b);
+            update<N - nmax> (p + nmax, a, b);
+        } else {
+            /* Over n bytes, b grows by n * a plus the bytes weighted by their
+               distance to the end, which removes the dependency between
+               iterations */
+            std::uint32_t s1 = 0;
+            std::uint32_t s2 = 0;
+
+            for (std::size_t i = 0; i < N; i++)
+            {
+                s1 += p[i];
+                s2 += static_cast<std::uint32_t> (N - i) * p[i];
+            }
+
+            b = static_cast<std::uint32_t> ((b + static_cast<std::uint64_t> (N) * a + s2) % base);
+            a = (a + s1) % base;
+        }
+    }
+};
+
+/* Change tracker for an array of T with a compile-time block size, hashed
+   with the compile-time kernel of Hasher. The block hashes are either kept in
+   an orhash_t, whose digest arrays the kernel fills, or in two caller-supplied
+   arrays of storage_bytes_for(count) bytes each, in which case construction
+   does not allocate. Both hold the same bytes as the C core computes. */
+template <class T, std::size_t BlockBytes = 4096, class Hasher = adler32>
+class tracker
+{
+    static_assert (std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+    static_assert (BlockBytes > 0, "the block size cannot be 0");
+
+public:
+    static constexpr std::size_t block_bytes = BlockBytes;
+    static constexpr std::size_t digest_len = Hasher::digest_len;
+
+    static constexpr std::size_t
+    num_blocks_for (std::size_t count) noexcept
+    {
+        return (count * sizeof (T) + BlockBytes - 1) / BlockBytes;
+    }
+
+    static constexpr std::size_t
+    storage_bytes_for (std::size_t count) noexcept
+    {
+        return num_blocks_for (count) * digest_len;
+    }
+
+    tracker (const T *data, std::size_t count)
+        : data_ (reinterpret_cast<const unsigned char*> (data)),
+          size_ (count * sizeof (T)),
+          num_blocks_ (num_blocks_for (count)),
+          hash_ (std::in_place, data, count * sizeof (T), BlockBytes)
+    {
+        if (hash_->get ()->digest_len != digest_len)
+            throw error ("tracker: digest length", ORHASH_ERR_BAD_PARAM);
+    }
+
+    tracker (const T *data, std::size_t count, unsigned char *digests, unsigned char *ref_digests) noexcept
+        : data_ (reinterpret_cast<const unsigned char*> (data)),
+          size_ (count * sizeof (T)),
+          num_blocks_ (num_blocks_for (count)),
+          digests_ (digests),
+          ref_digests_ (ref_digests)
+    {
+    }
+
+    template <class Container,
+              class = decltype (std::data (std::declval<const Container&> ()))>
+    explicit tracker (const Container &c)
+        : tracker (std::data (c), std::size (c))
+    {
+    }
+
+    tracker (tracker &&other) noexcept { *this = std::move (other); }
+
+    tracker &
+    operator= (tracker &&other) noexcept
+    {
+        data_           = std::exchange (other.data_, nullptr);
+        size_           = std::exchange (other.size_, 0);
+        num_blocks_     = std::exchange (other.num_blocks_, 0);
+        hash_           = std::move (other.hash_);
+        other.hash_.reset ();
+        digests_        = std::exchange (other.digests_, nullptr);
+        ref_digests_    = std::exchange (other.ref_digests_, nullptr);
+        return *this;
+    }
+
+    tracker (const tracker &) = delete;
+    tracker &operator= (const tracker &) = delete;
+
+    void
+    compute ()
+    {
+        orhash_t *h = get ();
+
+        if (h != nullptr && !kernel_applies (h))
+        {
+            hash_->compute ();
+            return;
+        }
+
+        std::size_t full_blocks = size_ / BlockBytes;
+
+        for (std::size_t i = 0; i < full_blocks; i++)
+            Hasher::store (Hasher::template hash<BlockBytes> (data_ + i * BlockBytes), digest (h, i));
+
+        if (full_blocks < num_blocks_)
+            Hasher::store (Hasher::hash (data_ + full_blocks * BlockBytes, size_ - full_blocks * BlockBytes),
+                           digest (h, full_blocks));
+    }
+
+    void
+    set_reference ()
+    {
+        if (hash_)
+            hash_->set_reference ();
+        else
+            std::memcpy (ref_digests_, digests_, num_blocks_ * digest_len);
+    }
+
+    /* bitmap must hold ORHASH_BITMAP_WORDS(num_blocks()) words */
+    std::size_t
+    dirty_blocks (std::uint64_t *bitmap = nullptr) const
+    {
+        if (hash_)
+            return hash_->dirty_blocks (bitmap);
+
+        return orhash_compare_digests (digests_, ref_digests_, num_blocks_, digest_len, bitmap);
+    }
+
+    double
+    dirty_ratio () const
+    {
+        return num_blocks_ == 0 ? 0.0 : static_cast<double> (dirty_blocks ()) / num_blocks_;
+    }
+
+    std::size_t num_blocks () const noexcept { return num_blocks_; }
+
+    /* The orhash_t holding the hashes, nullptr with caller-supplied storage */
+    orhash_t *get () const noexcept { return hash_ ? hash_->get () : nullptr; }
+
+private:
+    /* The kernel only replaces the plain hashing of the core: features set on
+       the orhash_t through get() that transform or sample the data, or that
+       shift the blocks, are left to the core */
+    bool
+    kernel_applies (const orhash_t *h) const noexcept
+    {
+        if (h->tol_mode != ORHASH_TOL_NONE || h->cost_ratio != nullptr || h->versions != nullptr ||
+            h->stream_distance != 0 || h->num_blocks != num_blocks_)
+            return false;
+
+        for (std::size_t i = 0; i < num_blocks_; i++)
+        {
+            if (h->hash[i]->index != h->hash_start_index + static_cast<long> (i))
+                return false;
+        }
+
+        return true;
+    }
+
+    unsigned char *
+    digest (orhash_t *h, std::size_t i) const noexcept
+    {
+        if (h == nullptr)
+            return digests_ + i * digest_len;
+
+        /* The hash of the block changed, it is not confirmed by its strong
+           hash anymore */
+        h->hash[i]->strong_valid = 0;
+        return h->hash[i]->hash;
+    }
+
+    const unsigned char         *data_          = nullptr;
+    std::size_t                 size_           = 0;
+    std::size_t                 num_blocks_     = 0;
+    std::optional<orhash::hash> hash_;
+    unsigned char               *digests_       = nullptr;
+    unsigned char               *ref_digests_   = nullptr;
+};
+
+} /* namespace orhash */
+
+#endif /* INCLUDE_ORHASH_HPP */
@@ -21,4 +21,47 @@ typedef enum orhash_cmp_e {
     ORHASH_HASHES_DIFFER,
 } orhash_cmp_t;
 
+/* How the data associated to a hash is accessed */
+typedef enum orhash_io_mode_e {
+    ORHASH_IO_MEMORY        = 0,    /* Buffer in memory provided by the caller */
+    ORHASH_IO_MMAP,                 /* File range mapped with mmap() */
+    ORHASH_IO_PREAD,                /* File range read with pread() and readahead */
+    ORHASH_IO_DIRECT,               /* File range read with pread() and O_DIRECT */
+} orhash_io_mode_t;
+
+/* Type of the elements of the buffer, used to ignore insignificant changes */
+typedef enum orhash_elem_type_e {
+    ORHASH_TYPE_RAW         = 0,    /* Bytes, hashed as is */
+    ORHASH_TYPE_FLOAT,
+    ORHASH_TYPE_DOUBLE,
+    ORHASH_TYPE_INT32,
+    ORHASH_TYPE_INT64,
+} orhash_elem_type_t;
+
+typedef enum orhash_tol_mode_e {
+    ORHASH_TOL_NONE         = 0,
+    ORHASH_TOL_ABSOLUTE,            /* Values are quantized to multiples of the tolerance */
+    ORHASH_TOL_RELATIVE,            /* Mantissas are truncated to the tolerance */
+} orhash_tol_mode_t;
+
+/* Duplicate map entry of blocks that only contain zeros */
+#define ORHASH_DEDUP_ZERO_BLOCK (-1)
+
+/* Bitmaps of dirty blocks, one bit per block */
+#define ORHASH_BITMAP_WORDS(n)      (((n) + 63) / 64)
+#define ORHASH_BITMAP_TEST(b, i)    (((b)[(i) / 64] >> ((i) % 64)) & 1)
+#define ORHASH_BITMAP_SET(b, i)     ((b)[(i) / 64] |= (UINT64_C(1) << ((i) % 64)))
+
+#define ORHASH_CACHE_LINE_SIZE      (64)
+#define ORHASH_STREAM_CHUNK_SIZE    (256)   /* Bytes hashed between prefetches */
+#define ORHASH_DEFAULT_STREAM_DISTANCE (1024)   /* Bytes prefetched ahead */
+
+#define ORHASH_DEFAULT_COST_STRIDE  (4096)  /* Bytes between compressibility samples */
+
+#define ORHASH_DEFAULT_SPARSE_REGION_BLOCKS (1024)   /* Blocks per region of a sparse hash */
+
+#define ORHASH_DEFAULT_IO_DEPTH (8)     /* Reads in flight in pread modes */
+#define ORHASH_FILE_READ_SIZE   (1 << 20)   /* Bytes per read in pread modes */
+#define ORHASH_DIRECT_IO_ALIGN  (4096)  /* Alignment required by O_DIRECT */
+
 #endif /* INCLUDE_ORHASH_CONSTANTS_H */
@@ -11,7 +11,10 @@
 
 typedef struct blockhash_s {
     unsigned char   *hash;
-    int             index;
+    unsigned char   *strong;        /* Only allocated when strong hashes are used */
+    int             strong_valid;   /* Reference: strong hash is computed;
+                                       current: strong hash matches the reference */
+    long            index;
 } blockhash_t;
 
 typedef struct orhash_s {
@@ -22,9 +25,93 @@ typedef struct orhash_s {
     size_t          block_size;
     size_t          num_blocks;
     size_t          last_block_size;
-    int             hash_start_index;
-    int             refhash_start_index;
+    long            hash_start_index;
+    long            refhash_start_index;
     MHASH           td;
+    orhash_io_mode_t io_mode;
+    int             fd;
+    off_t           file_offset;
+    void            *map_addr;
+    size_t          map_size;
+    int             io_depth;
+    orhash_elem_type_t elem_type;
+    orhash_tol_mode_t tol_mode;
+    double          tolerance;
+    double          tol_scale;
+    long            tol_quantum;
+    uint64_t        tol_mask;
+    void            *tol_scratch;
+    int             strong_algo_set;
+    hashid          strong_algo;
+    size_t          num_weak_collisions;
+    size_t          digest_len;
+    unsigned char   *digests;       /* Block hashes, contiguous */
+    unsigned char   *ref_digests;   /* Block reference hashes, contiguous */
+    size_t          stream_distance; /* Bytes prefetched ahead, 0 when not streaming */
+    uint64_t        *versions;      /* Per block write counters, odd while written */
+    uint64_t        *epoch;         /* Write counters when the pass started */
+    int             epoch_set;      /* The epoch of the next pass is already taken */
+    unsigned char   *unstable;      /* Blocks written while hashed */
+    unsigned char   *ref_unstable;  /* Same for the reference */
+    pthread_t       compute_thread;
+    int             compute_running;
+    int             compute_rc;
+    float           *cost_ratio;    /* Estimated compressed size / size, per block */
+    size_t          cost_stride;    /* Bytes between compressibility samples */
+    size_t          sparse_region_blocks;   /* Blocks per region of a sparse hash */
+    size_t          num_sparse_regions;
+    size_t          num_sparse_allocated;
+    unsigned char   **sparse_digests;       /* Per region, block hashes then reference
+                                               hashes; NULL while only zeros */
+    unsigned char   *sparse_flags;
+    unsigned char   *sparse_scratch;
 } orhash_t;
 
+/* Result of the duplicate block analysis of a hash. map[i] is the index of
+   the first block with the same content as block i (i itself for unique
+   blocks), or ORHASH_DEDUP_ZERO_BLOCK if block i only contains zeros */
+typedef struct orhash_dedup_s {
+    size_t          num_blocks;
+    size_t          num_unique;
+    size_t          num_duplicates;
+    size_t          num_zero;
+    long            *map;
+    int             verified;
+} orhash_dedup_t;
+
+/* Predicted size of the next checkpoint, after compression */
+typedef struct orhash_cost_s {
+    size_t          full_bytes;             /* All the blocks */
+    size_t          incremental_bytes;      /* Dirty blocks and the list of blocks */
+    size_t          raw_full_bytes;         /* Same without compression */
+    size_t          raw_incremental_bytes;
+    size_t          num_dirty;
+} orhash_cost_t;
+
+/* Ring buffer of dirty ratios sampled over time, globally and for
+   num_regions ranges of consecutive blocks, with the fitted dirty rates */
+typedef struct orhash_history_s {
+    orhash_t        *hash;
+    size_t          num_blocks;
+    size_t          capacity;
+    size_t          num_samples;
+    size_t          next;           /* Slot of the next sample */
+    size_t          num_regions;
+    double          *times;         /* Time or iterations since the reference */
+    double          *ratios;
+    float           *region_ratios; /* num_regions values per sample */
+    double          *region_rates;  /* Fitted rate at which blocks get dirty */
+    double          *region_bytes;  /* Bytes written when a region is dirty */
+    uint64_t        *bitmap;
+    int             fitted;
+} orhash_history_t;
+
+/* System parameters for the checkpoint interval, in the unit of time of the
+   history samples */
+typedef struct orhash_ckpt_params_s {
+    double          write_bandwidth;    /* Bytes per unit of time */
+    double          failure_rate;       /* Failures per unit of time, 1 / MTBF */
+    double          latency;            /* Fixed cost of a checkpoint */
+} orhash_ckpt_params_t;
+
 #endif /* INCLUDE_ORHASH_TYPES_H */
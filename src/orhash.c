@@ -4,7 +4,9 @@
  *
  */
 
-#include "orhash.h"
+#include <string.h>
+
+#include "orhash_internal.h"
 
 static void
 _print_orhash_metadata (orhash_t *orhash)
@@ -20,8 +22,8 @@ _print_orhash_metadata (orhash_t *orhash)
     printf ("Last block size: %zd\n", orhash->last_block_size);
     printf ("Array of block hashes: %p\n", (void*)orhash->hash);
     printf ("Array of block reference hashes: %p\n", (void*) orhash->ref_hash);
-    printf ("Block hash start index: %d\n", orhash->hash_start_index);
-    printf ("Block reference hash start index: %d\n", orhash->refhash_start_index);
+    printf ("Block hash start index: %ld\n", orhash->hash_start_index);
+    printf ("Block reference hash start index: %ld\n", orhash->refhash_start_index);
 }
 
 /* The index is the block number, not the index of the block */
@@ -30,11 +32,11 @@ _print_orhash_metadata (orhash_t *orhash)
    the following logical indexes: (-1, 0, 1, 2, 3) for an array of size 5
    which is stored as follow (0, 1, 2, -1, 3) where a block was first
    added to the front and then another block to the end */
-static blockhash_t *
-_find_block_hash (orhash_t *orhash, int index)
+blockhash_t *
+_orhash_find_block_hash (orhash_t *orhash, long index)
 {
-    int logical_index;
-    int i;
+    long    logical_index;
+    size_t  i;
 
     if (orhash == NULL)
         return NULL;
@@ -42,6 +44,10 @@ _find_block_hash (orhash_t *orhash, int index)
     /* We need to calculate the logical index we are looking for */
     logical_index = orhash->hash_start_index + index;
 
+    /* Unless blocks were shifted, the block is where it logically is */
+    if (index >= 0 && (size_t)index < orhash->num_blocks && orhash->hash[index]->index == logical_index)
+        return orhash->hash[index];
+
     for (i = 0; i < orhash->num_blocks; i++)
     {
         if (orhash->hash[i]->index == logical_index)
@@ -51,11 +57,11 @@ _find_block_hash (orhash_t *orhash, int index)
     return NULL;
 }
 
-static blockhash_t *
-_find_block_refhash (orhash_t *orhash, int index)
+blockhash_t *
+_orhash_find_block_refhash (orhash_t *orhash, long index)
 {
-    int logical_index;
-    int i;
+    long    logical_index;
+    size_t  i;
 
     if (orhash == NULL)
         return NULL;
@@ -63,6 +69,9 @@ _find_block_refhash (orhash_t *orhash, int index)
     /* We need to calculate the logical index we are looking for */
     logical_index = orhash->refhash_start_index + index;
 
+    if (index >= 0 && (size_t)index < orhash->num_blocks && orhash->ref_hash[index]->index == logical_index)
+        return orhash->ref_hash[index];
+
     for (i = 0; i < orhash->num_blocks; i++)
     {
         if (orhash->ref_hash[i]->index == logical_index)
@@ -73,73 +82,211 @@ _find_block_refhash (orhash_t *orhash, int index)
 }
 
 static void
-_print_hash (unsigned char *hash)
+_print_hash (unsigned char *hash, size_t len)
 {
-    int             i;
-    MHASH           td;
+    size_t          i;
 
     printf ("Hash: ");
-    for (i = 0; i < mhash_get_block_size (MHASH_ADLER32); i++)
+    for (i = 0; i < len; i++)
     {
         printf ("%.2x", hash[i]);
     }
     printf ("\n");
 }
 
+/* Block hashes are stored contiguously, in the order of the array of block
+   hashes, so they can be compared many at a time; the blockhash_t structures
+   point into these arrays */
 static int
-_compare_hash (unsigned char *hash1, unsigned char *hash2)
+_alloc_digests (orhash_t *orhash, unsigned char **digests, blockhash_t **blocks, size_t old_num_blocks)
 {
-    int i;
+    unsigned char   *d;
+    size_t          i;
 
-    for (i = 0; i < mhash_get_block_size (MHASH_ADLER32); i++)
-    {
-        if (hash1[i] != hash2[i])
-        {
-            return ORHASH_HASHES_DIFFER;
-        }
-    }
+    d = realloc (*digests, orhash->num_blocks * orhash->digest_len);
+    if (d == NULL)
+        return ORHASH_ERROR;
 
-    return ORHASH_EQUAL_HASHES;
+    memset (d + old_num_blocks * orhash->digest_len,
+            0,
+            (orhash->num_blocks - old_num_blocks) * orhash->digest_len);
+
+    *digests = d;
+
+    /* The array may have moved */
+    for (i = 0; i < old_num_blocks; i++)
+        blocks[i]->hash = d + i * orhash->digest_len;
+
+    return ORHASH_SUCCESS;
 }
 
-static int
-_compute_block_hash (orhash_t *orhash, blockhash_t *block_hash, int block_index, size_t size)
+/* Hash a block of data, wherever it comes from (buffer, mapping or read from a
+   file), so all the modes produce compatible block hashes */
+int
+_orhash_hash_data (void *ptr, size_t size, hashid algo, unsigned char *digest)
 {
-    void    *ptr;
     MHASH   td;
-    int     internal_block_index;
 
-    if (orhash == NULL || block_hash == NULL)
+    if (ptr == NULL || digest == NULL)
         return ORHASH_ERR_BAD_PARAM;
 
-    td = mhash_init (MHASH_ADLER32);
+    td = mhash_init (algo);
 
     if (td == MHASH_FAILED)
     {
         return ORHASH_ERROR;
     }
 
-    ptr = orhash->buffer + (block_index * orhash->block_size);
-
     mhash (td, ptr, size);
 
-    mhash_deinit (td, block_hash->hash);
+    mhash_deinit (td, digest);
 
     return ORHASH_SUCCESS;
 }
 
-static size_t
-_calculate_num_blocks (size_t buffer_size, size_t block_size)
+/* Whether the size bytes at ptr are all zeros */
+int
+_orhash_is_zero (const void *ptr, size_t size)
+{
+    const unsigned char *c = ptr;
+    size_t              i;
+
+    for (i = 0; i < size; i++)
+    {
+        if (c[i] != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Hash a block of the buffer, after discarding the changes below the
+   tolerance when one is set */
+static int
+_hash_block_with (orhash_t *orhash, void *ptr, size_t size, hashid algo, unsigned char *digest)
+{
+    if (orhash->tol_mode != ORHASH_TOL_NONE)
+        ptr = _orhash_tolerance_apply (orhash, ptr, size, &size);
+
+    return _orhash_hash_data (ptr, size, algo, digest);
+}
+
+int
+_orhash_hash_block (orhash_t *orhash, void *ptr, size_t size, unsigned char *digest)
+{
+    return _hash_block_with (orhash, ptr, size, MHASH_ADLER32, digest);
+}
+
+/* Strong hash of the block currently stored at physical position i in the
+   array of block hashes */
+static int
+_compute_strong_hash (orhash_t *orhash, size_t i, unsigned char *digest)
+{
+    long    logical_index;
+    size_t  size;
+    void    *ptr;
+
+    logical_index = orhash->hash[i]->index - orhash->hash_start_index;
+    if (logical_index < 0 || logical_index >= orhash->num_blocks)
+        return ORHASH_ERROR;
+
+    size = (logical_index == orhash->num_blocks - 1) ? orhash->last_block_size : orhash->block_size;
+    ptr = (char*)orhash->buffer + logical_index * orhash->block_size;
+
+    return _hash_block_with (orhash, ptr, size, orhash->strong_algo, digest);
+}
+
+/* Prefetch the cache lines of the buffer in [start, start + size) with a
+   non-temporal hint so that the data hashed only once does not evict the
+   working set of the application from the caches */
+static void
+_prefetch_lines (orhash_t *orhash, size_t start, size_t size)
+{
+    size_t  end;
+    size_t  off;
+
+    if (start >= orhash->buffer_size)
+        return;
+
+    end = start + size;
+    if (end > orhash->buffer_size)
+        end = orhash->buffer_size;
+
+    for (off = start; off < end; off += ORHASH_CACHE_LINE_SIZE)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch ((char*)orhash->buffer + off, 0, 0);
+#endif
+    }
+}
+
+/* Hash a block in chunks; before each chunk, the lines stream_distance bytes
+   ahead of it are prefetched, so that only a few KiB of the buffer are in
+   flight in the caches at any time */
+static int
+_hash_block_streaming (orhash_t *orhash, size_t block_index, size_t size, unsigned char *digest)
 {
-    div_t o;
+    MHASH   td;
+    size_t  start = block_index * orhash->block_size;
+    size_t  off;
+    size_t  chunk;
+    size_t  len;
+    void    *ptr;
 
-    o = div (buffer_size, block_size);
+    td = mhash_init (MHASH_ADLER32);
+    if (td == MHASH_FAILED)
+        return ORHASH_ERROR;
 
-    if (o.rem != 0)
+    for (off = 0; off < size; off += chunk)
     {
-        return (o.quot + 1);
+        chunk = (size - off < ORHASH_STREAM_CHUNK_SIZE) ? size - off : ORHASH_STREAM_CHUNK_SIZE;
+
+        _prefetch_lines (orhash, start + off + orhash->stream_distance, chunk);
+
+        /* Chunks are multiples of the element size, see orhash_set_tolerance() */
+        ptr = (char*)orhash->buffer + start + off;
+        len = chunk;
+        if (orhash->tol_mode != ORHASH_TOL_NONE)
+            ptr = _orhash_tolerance_apply (orhash, ptr, chunk, &len);
+
+        mhash (td, ptr, len);
+    }
+
+    mhash_deinit (td, digest);
+
+    return ORHASH_SUCCESS;
+}
+
+static int
+_compute_block_hash (orhash_t *orhash, blockhash_t *block_hash, size_t block_index, size_t size)
+{
+    void    *ptr;
+
+    if (orhash == NULL || block_hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    ptr = (char*)orhash->buffer + block_index * orhash->block_size;
+
+    /* The block is not confirmed clean by its strong hash anymore */
+    block_hash->strong_valid = 0;
+
+    _orhash_cost_update (orhash, block_index, ptr, size);
+
+    if (orhash->stream_distance > 0)
+        return _hash_block_streaming (orhash, block_index, size, block_hash->hash);
+
+    return _orhash_hash_block (orhash, ptr, size, block_hash->hash);
+}
+
+static size_t
+_calculate_num_blocks (size_t buffer_size, size_t block_size)
+{
+    /* div() works on int and would truncate buffers of 2 GiB or more */
+    if (buffer_size % block_size != 0)
+    {
+        return (buffer_size / block_size + 1);
     } else {
-        return (o.quot);
+        return (buffer_size / block_size);
     }
 }
 
@@ -156,56 +303,96 @@ _calculate_last_block_size (size_t buffer_size, size_t block_size, size_t num_bl
 void
 orhash_print (orhash_t *orhash)
 {
-    int         i;
+    size_t      i;
     blockhash_t *blockhash;
 
     if (orhash == NULL)
         return;
 
     _print_orhash_metadata (orhash);
-    
+
+    /* Sparse hashes have no array of block hashes */
+    if (orhash->sparse_digests != NULL)
+        return;
+
     printf ("Block hashes:\n");
     for (i = 0; i < orhash->num_blocks; i++)
     {
-        blockhash = _find_block_hash (orhash, i);
+        blockhash = _orhash_find_block_hash (orhash, i);
         if (blockhash == NULL)
         {
             fprintf (stderr, "Block hash not found\n");
             return;
         }
 
-        _print_hash (blockhash->hash);
+        _print_hash (blockhash->hash, orhash->digest_len);
     }
 
     printf ("Block reference hashes:\n");
     for (i = 0; i < orhash->num_blocks; i++)
     {   
-        blockhash = _find_block_refhash (orhash, i);
+        blockhash = _orhash_find_block_refhash (orhash, i);
         if (blockhash == NULL)
         {
             fprintf (stderr, "Block hash not found\n");
             return;
         }
 
-        _print_hash (blockhash->hash);
+        _print_hash (blockhash->hash, orhash->digest_len);
     }
 }
 
+int
+orhash_set_streaming (orhash_t *hash, int enable, size_t prefetch_distance)
+{
+    if (hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (!enable)
+    {
+        hash->stream_distance = 0;
+        return ORHASH_SUCCESS;
+    }
+
+    if (prefetch_distance == 0)
+        prefetch_distance = ORHASH_DEFAULT_STREAM_DISTANCE;
+
+    hash->stream_distance = (prefetch_distance + ORHASH_CACHE_LINE_SIZE - 1) /
+                            ORHASH_CACHE_LINE_SIZE * ORHASH_CACHE_LINE_SIZE;
+
+    return ORHASH_SUCCESS;
+}
+
 int
 orhash_compute_hash (orhash_t *orhash)
 {
-    int         i;
+    size_t      i;
     int         rc;
     blockhash_t *block_hash;
 
     if (orhash == NULL)
         return ORHASH_ERR_BAD_PARAM;
 
+    /* Files that are not mapped in memory are read block by block */
+    if (orhash->io_mode == ORHASH_IO_PREAD || orhash->io_mode == ORHASH_IO_DIRECT)
+        return _orhash_file_compute_hash (orhash);
+
+    if (orhash->versions != NULL)
+        return _orhash_concurrent_compute_hash (orhash);
+
+    if (orhash->sparse_digests != NULL)
+        return _orhash_sparse_compute_hash (orhash);
+
+    /* In streaming mode, the blocks are hashed with a window of prefetched
+       data ahead of them, which is first filled here */
+    if (orhash->stream_distance > 0)
+        _prefetch_lines (orhash, 0, orhash->stream_distance);
+
     if (orhash->num_blocks > 1)
     {
         for (i = 0; i < orhash->num_blocks - 1; i++)
         {
-            block_hash = _find_block_hash (orhash, i);
+            block_hash = _orhash_find_block_hash (orhash, i);
             if (block_hash == NULL)
                 return ORHASH_ERROR;
 
@@ -219,7 +406,7 @@ orhash_compute_hash (orhash_t *orhash)
 
 
     /* The last block is a special case because its data size is not necessarily the block size */
-    block_hash = _find_block_hash (orhash, orhash->num_blocks - 1);
+    block_hash = _orhash_find_block_hash (orhash, orhash->num_blocks - 1);
     if (block_hash == NULL)
         return ORHASH_ERROR;
 
@@ -235,29 +422,119 @@ orhash_compute_hash (orhash_t *orhash)
 int
 orhash_set_ref_hash (orhash_t *orhash)
 {
-    int i;
-    int j;
+    size_t  i;
 
     if (orhash == NULL)
         return ORHASH_ERR_BAD_PARAM;
 
+    if (orhash->sparse_digests != NULL)
+        return _orhash_sparse_set_ref_hash (orhash);
 
-    for (i = 0; i < orhash->num_blocks; i++)
+    for (i = 0; orhash->strong_algo_set && i < orhash->num_blocks; i++)
     {
-        unsigned char *hash1;
-        unsigned char *hash2;
-
-        hash1 = orhash->hash[i]->hash;
-        hash2 = orhash->ref_hash[i]->hash;
+        /* The strong hash of the reference is only recomputed for blocks that
+           orhash_get_dirty_ratio() did not confirm clean since the last
+           orhash_compute_hash() */
+        if (!orhash->hash[i]->strong_valid)
+        {
+            if (_compute_strong_hash (orhash, i, orhash->ref_hash[i]->strong) != ORHASH_SUCCESS)
+                return ORHASH_ERROR;
 
-        memcpy (hash2, hash1, HASH_LEN * sizeof (unsigned char));
+            orhash->ref_hash[i]->strong_valid = 1;
+            orhash->hash[i]->strong_valid = 1;
+        }
     }
 
+    memcpy (orhash->ref_digests, orhash->digests, orhash->num_blocks * orhash->digest_len);
+
+    /* A reference taken while a block was written is not trusted either */
+    if (orhash->unstable != NULL)
+        memcpy (orhash->ref_unstable, orhash->unstable, orhash->num_blocks);
+
     orhash->refhash_start_index = orhash->hash_start_index;
 
     return ORHASH_SUCCESS;
 }
 
+int
+orhash_import_ref_hash (orhash_t *hash, orhash_t *from)
+{
+    size_t      i;
+    blockhash_t *src;
+    blockhash_t *dst;
+
+    if (hash == NULL || from == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (hash->sparse_digests != NULL || from->sparse_digests != NULL)
+        return ORHASH_ERR_NOT_IMPL;
+
+    if (hash->num_blocks != from->num_blocks ||
+        hash->block_size != from->block_size ||
+        hash->last_block_size != from->last_block_size)
+    {
+        fprintf (stderr, "The two hashes do not have the same block layout\n");
+        return ORHASH_ERR_BAD_PARAM;
+    }
+
+    /* Blocks are copied in logical order so the reference hashes of the two
+       hashes do not need to be stored in the same order */
+    for (i = 0; i < hash->num_blocks; i++)
+    {
+        src = _orhash_find_block_refhash (from, i);
+        dst = _orhash_find_block_refhash (hash, i);
+        if (src == NULL || dst == NULL)
+            return ORHASH_ERROR;
+
+        memcpy (dst->hash, src->hash, hash->digest_len);
+
+        /* The strong hash of the previous reference does not apply anymore */
+        dst->strong_valid = 0;
+    }
+
+    for (i = 0; i < hash->num_blocks; i++)
+        hash->hash[i]->strong_valid = 0;
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_set_strong_hash (orhash_t *hash, hashid algo)
+{
+    size_t  i;
+
+    if (hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (mhash_get_block_size (algo) == 0 || mhash_get_block_size (algo) > HASH_LEN)
+        return ORHASH_ERR_BAD_PARAM;
+
+    /* Strong hashes are computed from the data in place */
+    if (hash->io_mode != ORHASH_IO_MEMORY && hash->io_mode != ORHASH_IO_MMAP)
+        return ORHASH_ERR_NOT_IMPL;
+
+    if (hash->sparse_digests != NULL)
+        return ORHASH_ERR_NOT_IMPL;
+
+    for (i = 0; i < hash->num_blocks; i++)
+    {
+        if (hash->ref_hash[i]->strong == NULL)
+        {
+            hash->ref_hash[i]->strong = calloc (HASH_LEN, sizeof (unsigned char));
+            if (hash->ref_hash[i]->strong == NULL)
+                return ORHASH_ERROR;
+        }
+
+        hash->ref_hash[i]->strong_valid = 0;
+        hash->hash[i]->strong_valid = 0;
+    }
+
+    hash->strong_algo       = algo;
+    hash->strong_algo_set   = 1;
+
+    return ORHASH_SUCCESS;
+}
+
 int
 orhash_reinit (orhash_t *hash_in,
                void     *buffer,
@@ -266,18 +543,50 @@ orhash_reinit (orhash_t *hash_in,
 {
     long    n_new_blocks;
     size_t  old_num_blocks;
-    int     i;
+    long    i;
     int     rc;
 
-    if (hash_in == NULL)
+    if (hash_in == NULL || buffer == NULL)
         return ORHASH_ERR_BAD_PARAM;
 
+    if (hash_in->io_mode != ORHASH_IO_MEMORY)
+    {
+        fprintf (stderr, "Re-initializing a file-backed hash is not supported\n");
+        return ORHASH_ERR_NOT_IMPL;
+    }
+
+    if (hash_in->sparse_digests != NULL)
+    {
+        fprintf (stderr, "Re-initializing a sparse hash is not supported\n");
+        return ORHASH_ERR_NOT_IMPL;
+    }
+
+    if (hash_in->versions != NULL)
+    {
+        fprintf (stderr, "Re-initializing a hash with concurrent writers is not supported\n");
+        return ORHASH_ERR_NOT_IMPL;
+    }
+
+    if (hash_in->cost_ratio != NULL)
+    {
+        fprintf (stderr, "Re-initializing a hash with a cost model is not supported\n");
+        return ORHASH_ERR_NOT_IMPL;
+    }
+
+    if (hash_in->strong_algo_set)
+    {
+        fprintf (stderr, "Re-initializing a hash with strong hashes is not supported\n");
+        return ORHASH_ERR_NOT_IMPL;
+    }
+
     if (buffer_size < hash_in->buffer_size)
     {
         fprintf (stderr, "The buffer shrunk, operation not supported yet\n");
         goto exit_on_error;
     }
 
+    hash_in->buffer = buffer;
+
     /* Calculate the new number of blocks */
     if (buffer_size > hash_in->buffer_size)
     {
@@ -291,31 +600,62 @@ orhash_reinit (orhash_t *hash_in,
             n_new_blocks = block_offset;
         }
 
-        hash_in->num_blocks += n_new_blocks;
+        /* The new blocks must be exactly those added to the buffer */
+        if (_calculate_num_blocks (buffer_size, hash_in->block_size) != old_num_blocks + n_new_blocks)
+        {
+            fprintf (stderr, "The block offset does not match the growth of the buffer\n");
+            return ORHASH_ERR_BAD_PARAM;
+        }
 
+        hash_in->num_blocks += n_new_blocks;
 
-        /* Adjust the hashes for all blocks */
+        /* Adjust the hashes and the reference hashes for all blocks; the
+           reference of the new blocks is left empty so they are dirty */
         hash_in->hash = realloc (hash_in->hash, hash_in->num_blocks * sizeof (blockhash_t*));
-        for (i = old_num_blocks; i < hash_in->num_blocks; i++)
+        if (hash_in->hash == NULL)
+            return ORHASH_ERROR;
+
+        hash_in->ref_hash = realloc (hash_in->ref_hash, hash_in->num_blocks * sizeof (blockhash_t*));
+        if (hash_in->ref_hash == NULL)
+            return ORHASH_ERROR;
+
+        rc = _alloc_digests (hash_in, &hash_in->digests, hash_in->hash, old_num_blocks);
+        if (rc != ORHASH_SUCCESS)
+            return ORHASH_ERROR;
+
+        rc = _alloc_digests (hash_in, &hash_in->ref_digests, hash_in->ref_hash, old_num_blocks);
+        if (rc != ORHASH_SUCCESS)
+            return ORHASH_ERROR;
+
+        for (i = old_num_blocks; i < (long)hash_in->num_blocks; i++)
         {
-            int relative_idx = 0;
+            long relative_idx = i - old_num_blocks;
 
             hash_in->hash[i] = (blockhash_t*) malloc (sizeof (blockhash_t));
-            if (hash_in->hash[i] == NULL)
+            hash_in->ref_hash[i] = (blockhash_t*) malloc (sizeof (blockhash_t));
+            if (hash_in->hash[i] == NULL || hash_in->ref_hash[i] == NULL)
                 return ORHASH_ERROR;
 
-            hash_in->hash[i]->hash = calloc (HASH_LEN, sizeof (unsigned char));
-            if (hash_in->hash[i]->hash == NULL)
-                return ORHASH_ERROR;
+            hash_in->hash[i]->hash = hash_in->digests + i * hash_in->digest_len;
+            hash_in->hash[i]->strong = NULL;
+            hash_in->hash[i]->strong_valid = 0;
 
             if (block_offset < 0)
             {
                 hash_in->hash[i]->index = hash_in->hash_start_index - relative_idx - 1;
             } else {
-                hash_in->hash[i]->index = hash_in->num_blocks + relative_idx;
+                hash_in->hash[i]->index = hash_in->hash_start_index + old_num_blocks + relative_idx;
             }
+
+            hash_in->ref_hash[i]->hash = hash_in->ref_digests + i * hash_in->digest_len;
+            hash_in->ref_hash[i]->strong = NULL;
+            hash_in->ref_hash[i]->strong_valid = 0;
+            hash_in->ref_hash[i]->index = hash_in->hash[i]->index;
         }
 
+        hash_in->buffer_size = buffer_size;
+        hash_in->last_block_size = _calculate_last_block_size (buffer_size, hash_in->block_size, hash_in->num_blocks);
+
         /* Adjust the start index; remember that because we want to handle the shift
            of blocks without ending up with wrongly high dirty ratios, the start index
            is negative when blocks have been added to the front of the list */
@@ -367,13 +707,63 @@ orhash_reinit (orhash_t *hash_in,
     return ORHASH_ERROR;
 }
 
+/* Set all the fields of a hash without allocating the block hashes */
+void
+_orhash_init_fields (orhash_t *h, void *buffer, size_t buffer_size, size_t block_size)
+{
+    h->buffer                = buffer;
+    h->buffer_size           = buffer_size;
+    h->block_size            = block_size;
+    h->num_blocks            = _calculate_num_blocks (buffer_size, block_size);
+    h->last_block_size       = _calculate_last_block_size (buffer_size, block_size, h->num_blocks);
+    h->hash_start_index      = 0;
+    h->refhash_start_index   = 0;
+    h->io_mode               = ORHASH_IO_MEMORY;
+    h->fd                    = -1;
+    h->file_offset           = 0;
+    h->map_addr              = NULL;
+    h->map_size              = 0;
+    h->io_depth              = 0;
+    h->elem_type             = ORHASH_TYPE_RAW;
+    h->tol_mode              = ORHASH_TOL_NONE;
+    h->tolerance             = 0.0;
+    h->tol_scale             = 0.0;
+    h->tol_quantum           = 0;
+    h->tol_mask              = 0;
+    h->tol_scratch           = NULL;
+    h->strong_algo_set       = 0;
+    h->strong_algo           = MHASH_ADLER32;
+    h->num_weak_collisions   = 0;
+    h->digest_len            = mhash_get_block_size (MHASH_ADLER32);
+    h->digests               = NULL;
+    h->ref_digests           = NULL;
+    h->stream_distance       = 0;
+    h->versions              = NULL;
+    h->epoch                 = NULL;
+    h->epoch_set             = 0;
+    h->unstable              = NULL;
+    h->ref_unstable          = NULL;
+    h->compute_running       = 0;
+    h->compute_rc            = ORHASH_SUCCESS;
+    h->cost_ratio            = NULL;
+    h->cost_stride           = 0;
+    h->hash                  = NULL;
+    h->ref_hash              = NULL;
+    h->sparse_region_blocks  = 0;
+    h->num_sparse_regions    = 0;
+    h->num_sparse_allocated  = 0;
+    h->sparse_digests        = NULL;
+    h->sparse_flags          = NULL;
+    h->sparse_scratch        = NULL;
+}
+
 int
 orhash_init (void       *buffer,
              size_t     buffer_size,
              size_t     block_size,
              orhash_t   **hash)
 {
-    int         i;
+    size_t      i;
     orhash_t    *_h;
 
     if (*hash != NULL)
@@ -388,18 +778,15 @@ orhash_init (void       *buffer,
         return ORHASH_ERROR;
     }
 
-    _h->buffer              = buffer;
-    _h->buffer_size         = buffer_size;
-    _h->block_size          = block_size;
-    _h->num_blocks          = _calculate_num_blocks (buffer_size, block_size);
-    _h->last_block_size     = _calculate_last_block_size (buffer_size, block_size, _h->num_blocks);
-    _h->hash_start_index    = 0;
-    _h->refhash_start_index = 0;
+    _orhash_init_fields (_h, buffer, buffer_size, block_size);
 
     _h->hash = (blockhash_t**) malloc (_h->num_blocks * sizeof (blockhash_t*));
     if (_h->hash == NULL)
         return ORHASH_ERROR;
 
+    if (_alloc_digests (_h, &_h->digests, _h->hash, 0) != ORHASH_SUCCESS)
+        return ORHASH_ERROR;
+
     for (i = 0; i < _h->num_blocks; i++)
     {
         _h->hash[i] = (blockhash_t*) malloc (sizeof (blockhash_t));
@@ -408,18 +795,19 @@ orhash_init (void       *buffer,
             return ORHASH_ERROR;
         }
 
-        _h->hash[i]->hash = calloc (HASH_LEN, sizeof (unsigned char));
-        if (_h->hash[i]->hash == NULL)
-        {
-            return ORHASH_ERROR;
-        }
+        _h->hash[i]->hash = _h->digests + i * _h->digest_len;
         _h->hash[i]->index = i;
+        _h->hash[i]->strong = NULL;
+        _h->hash[i]->strong_valid = 0;
     }
 
     _h->ref_hash = (blockhash_t**) malloc (_h->num_blocks * sizeof (blockhash_t*));
     if (_h->ref_hash == NULL)
         return ORHASH_ERROR;
 
+    if (_alloc_digests (_h, &_h->ref_digests, _h->ref_hash, 0) != ORHASH_SUCCESS)
+        return ORHASH_ERROR;
+
     for (i = 0; i < _h->num_blocks; i++)
     {
         _h->ref_hash[i] = (blockhash_t*) malloc (sizeof (blockhash_t));
@@ -428,12 +816,10 @@ orhash_init (void       *buffer,
             return ORHASH_ERROR;
         }
 
-        _h->ref_hash[i]->hash = calloc (HASH_LEN, sizeof (unsigned char));
-        if (_h->ref_hash[i]->hash == NULL)
-        {
-            return ORHASH_ERROR;
-        }
+        _h->ref_hash[i]->hash = _h->ref_digests + i * _h->digest_len;
         _h->ref_hash[i]->index = i;
+        _h->ref_hash[i]->strong = NULL;
+        _h->ref_hash[i]->strong_valid = 0;
     }
 
     *hash = _h;
@@ -444,29 +830,32 @@ orhash_init (void       *buffer,
 int
 orhash_fini (orhash_t **hash)
 {
-    int         i;
+    size_t      i;
     orhash_t    *_h;
 
-    if (hash == NULL || *hash == NULL || (*hash)->hash == NULL)
+    if (hash == NULL || *hash == NULL)
         return ORHASH_SUCCESS;
 
     _h = *hash;
 
-    for (i = 0; i < _h->num_blocks; i++)
+    /* A background computation may still be using the hashes */
+    _orhash_concurrent_fini (_h);
+
+    for (i = 0; _h->hash != NULL && i < _h->num_blocks; i++)
     {
         if (_h->hash[i] != NULL)
         {
-            free (_h->hash[i]->hash);
+            free (_h->hash[i]->strong);
             free (_h->hash[i]);
             _h->hash[i] = NULL;
         }
     }
 
-    for (i = 0; i < _h->num_blocks; i++)
+    for (i = 0; _h->ref_hash != NULL && i < _h->num_blocks; i++)
     {
         if (_h->ref_hash[i] != NULL)
         {
-            free (_h->ref_hash[i]->hash);
+            free (_h->ref_hash[i]->strong);
             free (_h->ref_hash[i]);
             _h->ref_hash[i] = NULL;
         }
@@ -476,6 +865,19 @@ orhash_fini (orhash_t **hash)
     _h->hash = NULL;
     free (_h->ref_hash);
     _h->ref_hash = NULL;
+    free (_h->digests);
+    _h->digests = NULL;
+    free (_h->ref_digests);
+    _h->ref_digests = NULL;
+
+    _orhash_file_fini (_h);
+    _orhash_sparse_fini (_h);
+
+    free (_h->tol_scratch);
+    _h->tol_scratch = NULL;
+
+    free (_h->cost_ratio);
+    _h->cost_ratio = NULL;
 
     free (*hash);
     *hash = NULL;
@@ -484,31 +886,123 @@ orhash_fini (orhash_t **hash)
 }
 
 int
-orhash_get_dirty_ratio (orhash_t *hash, double *ratio)
+orhash_get_dirty_blocks (orhash_t *hash, uint64_t *bitmap, size_t *num_dirty)
 {
-    int             i;
-    double          n_similar   = 0.0;
-    double          n_differ    = 0.0;
-    double          dirty_ratio = 0.0;
-    unsigned char   *hash1;
-    unsigned char   *hash2;
+    size_t          i;
+    size_t          n_differ;
+    size_t          strong_len;
+    long            logical_index;
+    uint64_t        *_bitmap    = bitmap;
+    unsigned char   strong[HASH_LEN];
+
+    if (hash == NULL || num_dirty == NULL)
+        return ORHASH_ERR_BAD_PARAM;
 
-    for (i = 0; i < hash->num_blocks; i++)
+    if (hash->sparse_digests != NULL)
+        return _orhash_sparse_get_dirty_blocks (hash, bitmap, num_dirty);
+
+    /* The block hashes are compared in storage order. Strong hashes and
+       concurrent writes are checked for the clean blocks of that bitmap, and
+       after orhash_reinit() shifted the blocks, it is translated to the
+       logical order of the blocks for the caller. */
+    if ((_bitmap == NULL && (hash->strong_algo_set || hash->unstable != NULL)) ||
+        (_bitmap != NULL && hash->hash_start_index != 0))
     {
-        hash1 = hash->hash[i]->hash;
-        hash2 = hash->ref_hash[i]->hash;
+        _bitmap = malloc (ORHASH_BITMAP_WORDS (hash->num_blocks) * sizeof (uint64_t));
+        if (_bitmap == NULL)
+            return ORHASH_ERROR;
+    }
 
-        if (_compare_hash(hash1, hash2) == ORHASH_EQUAL_HASHES)
+    n_differ = orhash_compare_digests (hash->digests,
+                                       hash->ref_digests,
+                                       hash->num_blocks,
+                                       hash->digest_len,
+                                       _bitmap);
+
+    /* Blocks written while they were hashed, now or for the reference, are
+       dirty whatever their hashes */
+    for (i = 0; hash->unstable != NULL && i < hash->num_blocks; i++)
+    {
+        if ((hash->unstable[i] || hash->ref_unstable[i]) && !ORHASH_BITMAP_TEST (_bitmap, i))
         {
-            n_similar++;
-        } else {
+            ORHASH_BITMAP_SET (_bitmap, i);
             n_differ++;
         }
     }
 
-    dirty_ratio = n_differ / (n_similar + n_differ);
-    *ratio = dirty_ratio;
+    strong_len = hash->strong_algo_set ? mhash_get_block_size (hash->strong_algo) : 0;
+
+    for (i = 0; hash->strong_algo_set && i < hash->num_blocks; i++)
+    {
+        if (ORHASH_BITMAP_TEST (_bitmap, i))
+            continue;
+
+        /* Already confirmed since the block was last hashed */
+        if (hash->hash[i]->strong_valid)
+            continue;
+
+        /* The weak hashes match, confirm with the strong hashes; without a
+           strong hash for the reference the block is conservatively dirty */
+        if (hash->ref_hash[i]->strong_valid)
+        {
+            if (_compute_strong_hash (hash, i, strong) != ORHASH_SUCCESS)
+                goto exit_on_error;
+
+            if (memcmp (strong, hash->ref_hash[i]->strong, strong_len) == 0)
+            {
+                hash->hash[i]->strong_valid = 1;
+                continue;
+            }
+
+            hash->num_weak_collisions++;
+        }
+
+        ORHASH_BITMAP_SET (_bitmap, i);
+        n_differ++;
+    }
+
+    if (bitmap != NULL && _bitmap != bitmap)
+    {
+        memset (bitmap, 0, ORHASH_BITMAP_WORDS (hash->num_blocks) * sizeof (uint64_t));
+
+        for (i = 0; i < hash->num_blocks; i++)
+        {
+            if (!ORHASH_BITMAP_TEST (_bitmap, i))
+                continue;
+
+            logical_index = hash->hash[i]->index - hash->hash_start_index;
+            if (logical_index >= 0 && (size_t)logical_index < hash->num_blocks)
+                ORHASH_BITMAP_SET (bitmap, logical_index);
+        }
+    }
+
+    if (_bitmap != bitmap)
+        free (_bitmap);
+
+    *num_dirty = n_differ;
 
     return ORHASH_SUCCESS;
+
+ exit_on_error:
+    if (_bitmap != bitmap)
+        free (_bitmap);
+    return ORHASH_ERROR;
 }
 
+int
+orhash_get_dirty_ratio (orhash_t *hash, double *ratio)
+{
+    size_t  n_differ;
+    int     rc;
+
+    if (hash == NULL || ratio == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    rc = orhash_get_dirty_blocks (hash, NULL, &n_differ);
+    if (rc != ORHASH_SUCCESS)
+        return rc;
+
+    *ratio = (double)n_differ / hash->num_blocks;
+
+    return ORHASH_SUCCESS;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "orhash_internal.h"
+
+/* Dirty mask of 64 consecutive 32-bit block hashes, bit i is set if hash i
+   differs from its reference */
+static uint64_t
+_compare_word32 (const uint32_t *a, const uint32_t *b)
+{
+    uint64_t    equal = 0;
+    int         i;
+
+#if defined(__AVX2__)
+    for (i = 0; i < 64; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256 ((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256 ((const __m256i*)(b + i));
+        __m256i e = _mm256_cmpeq_epi32 (x, y);
+
+        equal |= (uint64_t)(unsigned)_mm256_movemask_ps (_mm256_castsi256_ps (e)) << i;
+    }
+#elif defined(__SSE2__)
+    for (i = 0; i < 64; i += 4)
+    {
+        __m128i x = _mm_loadu_si128 ((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128 ((const __m128i*)(b + i));
+        __m128i e = _mm_cmpeq_epi32 (x, y);
+
+        equal |= (uint64_t)(unsigned)_mm_movemask_ps (_mm_castsi128_ps (e)) << i;
+    }
+#else
+    for (i = 0; i < 64; i++)
+        equal |= (uint64_t)(a[i] == b[i]) << i;
+#endif
+
+    return ~equal;
+}
+
+/* Compare the arrays of block hashes and of reference block hashes, 64 blocks
+   at a time for 32-bit hashes (e.g., Adler-32); returns the number of dirty
+   blocks and sets their bit in bitmap if not NULL */
+size_t
+orhash_compare_digests (const unsigned char     *digests,
+                        const unsigned char     *ref_digests,
+                        size_t                  num_blocks,
+                        size_t                  digest_len,
+                        uint64_t                *bitmap)
+{
+    size_t      n_differ = 0;
+    size_t      full_words;
+    size_t      w;
+    size_t      i;
+    uint64_t    word;
+
+    if (digest_len == sizeof (uint32_t))
+    {
+        full_words = num_blocks / 64;
+
+        for (w = 0; w < full_words; w++)
+        {
+            word = _compare_word32 ((const uint32_t*)digests + w * 64,
+                                    (const uint32_t*)ref_digests + w * 64);
+            n_differ += __builtin_popcountll (word);
+            if (bitmap != NULL)
+                bitmap[w] = word;
+        }
+
+        i = full_words * 64;
+    } else {
+        i = 0;
+    }
+
+    /* Remaining blocks, or all of them for other hash sizes */
+    for (; i < num_blocks; i++)
+    {
+        if (i % 64 == 0 && bitmap != NULL)
+            bitmap[i / 64] = 0;
+
+        if (memcmp (digests + i * digest_len, ref_digests + i * digest_len, digest_len) != 0)
+        {
+            n_differ++;
+            if (bitmap != NULL)
+                ORHASH_BITMAP_SET (bitmap, i);
+        }
+    }
+
+    return n_differ;
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+
+#include "orhash_internal.h"
+
+/* Each block has a version counter used like a sequence lock: writers make it
+   odd before writing and even again once done. The versions are copied into
+   an epoch when a pass starts, and once all the blocks are hashed, any block
+   whose version was odd or changed since the epoch is unstable: it was
+   written during the pass, before, while or after it was hashed. Writers
+   never wait and the hasher never blocks them. */
+
+static void
+_free_versions (orhash_t *orhash)
+{
+    free (orhash->versions);
+    orhash->versions = NULL;
+    free (orhash->epoch);
+    orhash->epoch = NULL;
+    free (orhash->unstable);
+    orhash->unstable = NULL;
+    free (orhash->ref_unstable);
+    orhash->ref_unstable = NULL;
+}
+
+/* Whether the hash of block i is stored at index i, i.e., orhash_reinit() did
+   not shift the blocks */
+static int
+_blocks_in_order (orhash_t *hash)
+{
+    size_t i;
+
+    for (i = 0; i < hash->num_blocks; i++)
+    {
+        if (hash->hash[i]->index != hash->hash_start_index + (long)i)
+            return 0;
+    }
+
+    return 1;
+}
+
+int
+orhash_set_concurrent (orhash_t *hash, int enable)
+{
+    if (hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (hash->compute_running)
+        return ORHASH_ERROR;
+
+    if (!enable)
+    {
+        _free_versions (hash);
+        return ORHASH_SUCCESS;
+    }
+
+    if (hash->io_mode != ORHASH_IO_MEMORY || hash->sparse_digests != NULL)
+        return ORHASH_ERR_NOT_IMPL;
+
+    /* The blocks are hashed in place, block i into the hash stored at i */
+    if (!_blocks_in_order (hash))
+    {
+        fprintf (stderr, "Concurrent mode is not supported once blocks were shifted\n");
+        return ORHASH_ERROR;
+    }
+
+    if (hash->versions != NULL)
+        return ORHASH_SUCCESS;
+
+    hash->versions      = calloc (hash->num_blocks, sizeof (uint64_t));
+    hash->epoch         = calloc (hash->num_blocks, sizeof (uint64_t));
+    hash->unstable      = calloc (hash->num_blocks, sizeof (unsigned char));
+    hash->ref_unstable  = calloc (hash->num_blocks, sizeof (unsigned char));
+    if (hash->versions == NULL || hash->epoch == NULL || hash->unstable == NULL || hash->ref_unstable == NULL)
+    {
+        _free_versions (hash);
+        return ORHASH_ERROR;
+    }
+
+    return ORHASH_SUCCESS;
+}
+
+static int
+_block_range (orhash_t *hash, size_t offset, size_t length, size_t *first, size_t *last)
+{
+    if (hash == NULL || hash->versions == NULL || length == 0 ||
+        offset >= hash->buffer_size || length > hash->buffer_size - offset)
+        return ORHASH_ERR_BAD_PARAM;
+
+    *first = offset / hash->block_size;
+    *last = (offset + length - 1) / hash->block_size;
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_write_begin (orhash_t *hash, size_t offset, size_t length)
+{
+    size_t  first;
+    size_t  last;
+    size_t  i;
+
+    if (_block_range (hash, offset, length, &first, &last) != ORHASH_SUCCESS)
+        return ORHASH_ERR_BAD_PARAM;
+
+    for (i = first; i <= last; i++)
+        __atomic_fetch_add (&hash->versions[i], 1, __ATOMIC_RELAXED);
+
+    /* The new versions must be visible before any of the writes that follow */
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_write_end (orhash_t *hash, size_t offset, size_t length)
+{
+    size_t  first;
+    size_t  last;
+    size_t  i;
+
+    if (_block_range (hash, offset, length, &first, &last) != ORHASH_SUCCESS)
+        return ORHASH_ERR_BAD_PARAM;
+
+    for (i = first; i <= last; i++)
+        __atomic_fetch_add (&hash->versions[i], 1, __ATOMIC_RELEASE);
+
+    return ORHASH_SUCCESS;
+}
+
+static void
+_take_epoch (orhash_t *orhash)
+{
+    size_t i;
+
+    for (i = 0; i < orhash->num_blocks; i++)
+        orhash->epoch[i] = __atomic_load_n (&orhash->versions[i], __ATOMIC_ACQUIRE);
+
+    orhash->epoch_set = 1;
+}
+
+int
+_orhash_concurrent_compute_hash (orhash_t *orhash)
+{
+    size_t      i;
+    size_t      size;
+    uint64_t    v;
+    int         rc;
+
+    /* The epoch of a background pass is taken by orhash_compute_hash_start() */
+    if (!orhash->epoch_set)
+        _take_epoch (orhash);
+    orhash->epoch_set = 0;
+
+    /* Blocks cannot be shifted in this mode (see orhash_set_concurrent()), so
+       block i is stored at index i */
+    for (i = 0; i < orhash->num_blocks; i++)
+    {
+        size = (i == orhash->num_blocks - 1) ? orhash->last_block_size : orhash->block_size;
+
+        rc = _orhash_hash_block (orhash,
+                                 (char*)orhash->buffer + i * orhash->block_size,
+                                 size,
+                                 orhash->hash[i]->hash);
+        if (rc != ORHASH_SUCCESS)
+            return ORHASH_ERROR;
+
+        _orhash_cost_update (orhash, i, (char*)orhash->buffer + i * orhash->block_size, size);
+        orhash->hash[i]->strong_valid = 0;
+    }
+
+    /* The reads of the blocks must complete before the versions are checked */
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    for (i = 0; i < orhash->num_blocks; i++)
+    {
+        v = __atomic_load_n (&orhash->versions[i], __ATOMIC_RELAXED);
+        orhash->unstable[i] = ((orhash->epoch[i] & 1) != 0 || orhash->epoch[i] != v);
+    }
+
+    return ORHASH_SUCCESS;
+}
+
+static void *
+_compute_thread (void *arg)
+{
+    orhash_t *orhash = arg;
+
+    orhash->compute_rc = orhash_compute_hash (orhash);
+
+    return NULL;
+}
+
+int
+orhash_compute_hash_start (orhash_t *hash)
+{
+    if (hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (hash->compute_running)
+        return ORHASH_ERROR;
+
+    /* Writes are tracked from now on, even before the thread starts hashing */
+    if (hash->versions != NULL)
+        _take_epoch (hash);
+
+    if (pthread_create (&hash->compute_thread, NULL, _compute_thread, hash) != 0)
+    {
+        hash->epoch_set = 0;
+        return ORHASH_ERROR;
+    }
+
+    hash->compute_running = 1;
+
+    return ORHASH_SUCCESS;
+}
+
+/* Wait for the background computation; returns its result */
+int
+orhash_compute_hash_wait (orhash_t *hash)
+{
+    if (hash == NULL || !hash->compute_running)
+        return ORHASH_ERR_BAD_PARAM;
+
+    pthread_join (hash->compute_thread, NULL);
+    hash->compute_running = 0;
+
+    return hash->compute_rc;
+}
+
+void
+_orhash_concurrent_fini (orhash_t *orhash)
+{
+    if (orhash == NULL)
+        return;
+
+    if (orhash->compute_running)
+        orhash_compute_hash_wait (orhash);
+
+    _free_versions (orhash);
+}
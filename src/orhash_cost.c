@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "orhash_internal.h"
+
+#define COST_WINDOW         (256)   /* Bytes examined at each sample point */
+#define COST_MATCH_BITS     (10)    /* Size of the table of 4-byte sequences */
+#define COST_MATCH_COST     (1.0 / 16.0)    /* Bytes written per matched byte */
+#define COST_MIN_RATIO      (1.0 / 64.0)    /* Best ratio assumed for any block */
+
+/* Per block compressibility estimate, from cheap signals gathered on samples
+   of the block while it is hashed:
+   - blocks only made of zeros, which do not need to be written at all,
+   - the byte entropy, which bounds what an entropy coder achieves,
+   - the fraction of bytes starting a 4-byte sequence already seen in the
+     sample, i.e., what an LZ4-like compressor would encode as matches.
+   The estimate is the fraction of the block size expected to be written. */
+
+static uint32_t
+_seq_hash (const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy (&v, p, sizeof (v));
+
+    return (v * 2654435761U) >> (32 - COST_MATCH_BITS);
+}
+
+static float
+_estimate_ratio (orhash_t *orhash, const unsigned char *p, size_t size)
+{
+    uint32_t        histogram[256];
+    uint16_t        table[1 << COST_MATCH_BITS];
+    size_t          n_sampled   = 0;
+    size_t          n_matched   = 0;
+    size_t          off;
+    size_t          len;
+    size_t          i;
+    uint32_t        h;
+    double          entropy     = 0.0;
+    double          ratio;
+
+    if (_orhash_is_zero (p, size))
+        return 0.0f;
+
+    memset (histogram, 0, sizeof (histogram));
+
+    for (off = 0; off < size; off += orhash->cost_stride)
+    {
+        len = size - off < COST_WINDOW ? size - off : COST_WINDOW;
+
+        /* Table entries hold the position in the window plus one */
+        memset (table, 0, sizeof (table));
+
+        for (i = 0; i < len; i++)
+            histogram[p[off + i]]++;
+
+        for (i = 0; i + 4 <= len; i++)
+        {
+            h = _seq_hash (p + off + i);
+            if (table[h] != 0 && memcmp (p + off + table[h] - 1, p + off + i, 4) == 0)
+                n_matched++;
+            table[h] = i + 1;
+        }
+
+        n_sampled += len;
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        if (histogram[i] != 0)
+        {
+            double f = (double)histogram[i] / n_sampled;
+            entropy -= f * log2 (f);
+        }
+    }
+
+    /* Matched bytes are almost free, the others cost their entropy */
+    ratio = (double)n_matched / n_sampled;
+    ratio = ratio * COST_MATCH_COST + (1.0 - ratio) * (entropy / 8.0);
+
+    if (ratio < COST_MIN_RATIO)
+        ratio = COST_MIN_RATIO;
+    if (ratio > 1.0)
+        ratio = 1.0;
+
+    return (float)ratio;
+}
+
+void
+_orhash_cost_update (orhash_t *orhash, size_t index, void *ptr, size_t size)
+{
+    if (orhash->cost_ratio == NULL || index >= orhash->num_blocks)
+        return;
+
+    orhash->cost_ratio[index] = _estimate_ratio (orhash, ptr, size);
+}
+
+int
+orhash_set_cost_model (orhash_t *hash, int enable, size_t sample_stride)
+{
+    if (hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (!enable)
+    {
+        free (hash->cost_ratio);
+        hash->cost_ratio = NULL;
+        return ORHASH_SUCCESS;
+    }
+
+    /* The estimates are per block, which defeats the purpose of sparse hashes */
+    if (hash->sparse_digests != NULL)
+        return ORHASH_ERR_NOT_IMPL;
+
+    if (sample_stride == 0)
+        sample_stride = ORHASH_DEFAULT_COST_STRIDE;
+    if (sample_stride < COST_WINDOW)
+        sample_stride = COST_WINDOW;
+
+    if (hash->cost_ratio == NULL)
+    {
+        /* Until the blocks are hashed, assume they do not compress */
+        size_t i;
+
+        hash->cost_ratio = malloc (hash->num_blocks * sizeof (float));
+        if (hash->cost_ratio == NULL)
+            return ORHASH_ERROR;
+
+        for (i = 0; i < hash->num_blocks; i++)
+            hash->cost_ratio[i] = 1.0f;
+    }
+
+    hash->cost_stride = sample_stride;
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_get_checkpoint_cost (orhash_t *hash, orhash_cost_t *cost)
+{
+    uint64_t    *bitmap;
+    size_t      num_dirty;
+    size_t      i;
+    size_t      size;
+    double      full        = 0.0;
+    double      incremental = 0.0;
+    int         rc;
+
+    if (hash == NULL || cost == NULL || hash->cost_ratio == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    bitmap = malloc (ORHASH_BITMAP_WORDS (hash->num_blocks) * sizeof (uint64_t));
+    if (bitmap == NULL)
+        return ORHASH_ERROR;
+
+    rc = orhash_get_dirty_blocks (hash, bitmap, &num_dirty);
+    if (rc != ORHASH_SUCCESS)
+    {
+        free (bitmap);
+        return rc;
+    }
+
+    memset (cost, 0, sizeof (orhash_cost_t));
+
+    /* Both the bitmap and the estimates follow the order of the blocks */
+    for (i = 0; i < hash->num_blocks; i++)
+    {
+        size = (i == hash->num_blocks - 1) ? hash->last_block_size : hash->block_size;
+
+        full += size * hash->cost_ratio[i];
+        cost->raw_full_bytes += size;
+
+        if (ORHASH_BITMAP_TEST (bitmap, i))
+        {
+            incremental += size * hash->cost_ratio[i];
+            cost->raw_incremental_bytes += size;
+        }
+    }
+
+    free (bitmap);
+
+    /* An incremental checkpoint also has to record which blocks it contains */
+    cost->num_dirty         = num_dirty;
+    cost->full_bytes        = (size_t) ceil (full);
+    cost->incremental_bytes = (size_t) ceil (incremental) +
+                              ORHASH_BITMAP_WORDS (hash->num_blocks) * sizeof (uint64_t);
+
+    return ORHASH_SUCCESS;
+}
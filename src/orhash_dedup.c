@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "orhash_internal.h"
+
+#define EMPTY_SLOT  (-1)
+
+typedef struct dedup_ctx_s {
+    orhash_t        *orhash;
+    blockhash_t     **blocks;       /* Block hashes in logical order */
+    size_t          digest_len;
+    int             verify;
+    int             in_memory;
+    void            *buf[2];        /* Blocks read back when not in memory */
+    hashid          strong_algo;
+    size_t          strong_len;
+    unsigned char   *strongs;       /* Strong hashes of the blocks read back */
+    unsigned char   *strong_set;    /* Whether the strong hash of a block is known */
+    int             rc;             /* Set when reading a block fails */
+    long            *slots;         /* Open addressing table of block indexes */
+    size_t          mask;
+} dedup_ctx_t;
+
+static size_t
+_block_data_size (orhash_t *orhash, size_t index)
+{
+    if (index == orhash->num_blocks - 1)
+        return orhash->last_block_size;
+
+    return orhash->block_size;
+}
+
+/* Data of a block, read into buffer slot if the data is not in memory */
+static void *
+_block_data (dedup_ctx_t *ctx, size_t index, int slot)
+{
+    orhash_t *orhash = ctx->orhash;
+
+    if (ctx->in_memory)
+        return (char*)orhash->buffer + index * orhash->block_size;
+
+    if (_orhash_file_read_block (orhash, index, ctx->buf[slot]) != ORHASH_SUCCESS)
+    {
+        ctx->rc = ORHASH_ERROR;
+        return NULL;
+    }
+
+    return ctx->buf[slot];
+}
+
+/* Block hashes are already well distributed but short ones only fill a few
+   bytes, mix them so that the low bits used to index the table all vary */
+static uint64_t
+_digest_key (unsigned char *digest, size_t len)
+{
+    uint64_t    key = 1469598103934665603ULL;
+    size_t      i;
+
+    for (i = 0; i < len; i++)
+    {
+        key ^= digest[i];
+        key *= 1099511628211ULL;
+    }
+
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+
+    return key;
+}
+
+/* Strong hash of a block read back from the file, computed once */
+static unsigned char *
+_block_strong (dedup_ctx_t *ctx, size_t index)
+{
+    unsigned char   *strong = ctx->strongs + index * ctx->strong_len;
+    void            *data;
+
+    if (ctx->strong_set[index])
+        return strong;
+
+    data = _block_data (ctx, index, 0);
+    if (data == NULL)
+        return NULL;
+
+    if (_orhash_hash_data (data, _block_data_size (ctx->orhash, index), ctx->strong_algo, strong) != ORHASH_SUCCESS)
+    {
+        ctx->rc = ORHASH_ERROR;
+        return NULL;
+    }
+    ctx->strong_set[index] = 1;
+
+    return strong;
+}
+
+/* Blocks with matching weak hashes are only duplicates once their data is
+   compared, when it is in memory or verification is on, or otherwise their
+   strong hashes match as well: callers do not store duplicates, so a weak
+   hash collision would lose data */
+static int
+_same_block (dedup_ctx_t *ctx, size_t a, size_t b)
+{
+    orhash_t        *orhash = ctx->orhash;
+    void            *data_a;
+    void            *data_b;
+    unsigned char   *strong_a;
+    unsigned char   *strong_b;
+
+    if (_block_data_size (orhash, a) != _block_data_size (orhash, b))
+        return 0;
+
+    if (memcmp (ctx->blocks[a]->hash, ctx->blocks[b]->hash, ctx->digest_len) != 0)
+        return 0;
+
+    if (ctx->in_memory || ctx->verify)
+    {
+        data_a = _block_data (ctx, a, 0);
+        data_b = _block_data (ctx, b, 1);
+
+        return data_a != NULL && data_b != NULL &&
+               memcmp (data_a, data_b, _block_data_size (orhash, a)) == 0;
+    }
+
+    strong_a = _block_strong (ctx, a);
+    strong_b = _block_strong (ctx, b);
+
+    return strong_a != NULL && strong_b != NULL && memcmp (strong_a, strong_b, ctx->strong_len) == 0;
+}
+
+/* Whether a block whose weak hash is the one of zeros really only holds
+   zeros, checked the same way as duplicates */
+static int
+_zero_block (dedup_ctx_t *ctx, size_t index, unsigned char zero_strong[2][HASH_LEN])
+{
+    orhash_t        *orhash = ctx->orhash;
+    unsigned char   *strong;
+    void            *data;
+
+    if (ctx->in_memory || ctx->verify)
+    {
+        data = _block_data (ctx, index, 0);
+
+        return data != NULL && _orhash_is_zero (data, _block_data_size (orhash, index));
+    }
+
+    strong = _block_strong (ctx, index);
+
+    return strong != NULL &&
+           memcmp (strong, zero_strong[index == orhash->num_blocks - 1 ? 1 : 0], ctx->strong_len) == 0;
+}
+
+/* Return the index of the first block identical to block index, inserting
+   the block in the table if it is the first of its kind */
+static long
+_lookup_or_insert (dedup_ctx_t *ctx, size_t index)
+{
+    size_t  slot;
+
+    slot = _digest_key (ctx->blocks[index]->hash, ctx->digest_len) & ctx->mask;
+
+    /* Linear probing; on a hash collision detected by the verification the
+       probing goes on so a later copy of either block still finds it */
+    while (ctx->slots[slot] != EMPTY_SLOT)
+    {
+        if (_same_block (ctx, ctx->slots[slot], index))
+            return ctx->slots[slot];
+
+        slot = (slot + 1) & ctx->mask;
+    }
+
+    ctx->slots[slot] = index;
+
+    return index;
+}
+
+/* Get the block hashes in logical order so that map entries point to the first
+   occurrence in the buffer, whatever the storage order left by orhash_reinit() */
+static int
+_sort_blocks (orhash_t *orhash, blockhash_t **blocks)
+{
+    size_t  i;
+    long    logical_index;
+
+    memset (blocks, 0, orhash->num_blocks * sizeof (blockhash_t*));
+
+    for (i = 0; i < orhash->num_blocks; i++)
+    {
+        logical_index = orhash->hash[i]->index - orhash->hash_start_index;
+        if (logical_index < 0 || logical_index >= orhash->num_blocks || blocks[logical_index] != NULL)
+            return ORHASH_ERROR;
+
+        blocks[logical_index] = orhash->hash[i];
+    }
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_dedup (orhash_t *hash, int verify, orhash_dedup_t **dedup)
+{
+    dedup_ctx_t     ctx;
+    orhash_dedup_t  *_d         = NULL;
+    unsigned char   zero_digest[2][HASH_LEN];
+    unsigned char   zero_strong[2][HASH_LEN];
+    void            *zero_block = NULL;
+    size_t          capacity;
+    size_t          i;
+    long            first;
+    int             rc;
+
+    if (hash == NULL || dedup == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (hash->sparse_digests != NULL)
+        return ORHASH_ERR_NOT_IMPL;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.orhash      = hash;
+    ctx.digest_len  = hash->digest_len;
+    ctx.verify      = verify;
+    ctx.rc          = ORHASH_SUCCESS;
+    ctx.strong_algo = hash->strong_algo_set ? hash->strong_algo : MHASH_SHA256;
+    ctx.strong_len  = mhash_get_block_size (ctx.strong_algo);
+
+    /* Verification and zero detection read the data in place, or read the
+       blocks back from the file */
+    ctx.in_memory = (hash->io_mode == ORHASH_IO_MEMORY || hash->io_mode == ORHASH_IO_MMAP);
+    if (!ctx.in_memory)
+    {
+        if (posix_memalign (&ctx.buf[0], ORHASH_DIRECT_IO_ALIGN, hash->block_size) != 0)
+            ctx.buf[0] = NULL;
+        if (posix_memalign (&ctx.buf[1], ORHASH_DIRECT_IO_ALIGN, hash->block_size) != 0)
+            ctx.buf[1] = NULL;
+        if (ctx.buf[0] == NULL || ctx.buf[1] == NULL)
+            goto exit_on_error;
+    }
+
+    /* Without verification, blocks read back are compared by strong hash */
+    if (!ctx.in_memory && !verify)
+    {
+        ctx.strongs = malloc (hash->num_blocks * ctx.strong_len);
+        ctx.strong_set = calloc (hash->num_blocks, sizeof (unsigned char));
+        if (ctx.strongs == NULL || ctx.strong_set == NULL)
+            goto exit_on_error;
+    }
+
+    /* Keep the load factor of the table at or below 1/2 */
+    capacity = 1;
+    while (capacity < 2 * hash->num_blocks)
+        capacity <<= 1;
+    ctx.mask = capacity - 1;
+
+    ctx.slots = malloc (capacity * sizeof (long));
+    ctx.blocks = malloc (hash->num_blocks * sizeof (blockhash_t*));
+    _d = calloc (1, sizeof (orhash_dedup_t));
+    if (ctx.slots == NULL || ctx.blocks == NULL || _d == NULL)
+        goto exit_on_error;
+
+    _d->map = malloc (hash->num_blocks * sizeof (long));
+    if (_d->map == NULL)
+        goto exit_on_error;
+
+    for (i = 0; i < capacity; i++)
+        ctx.slots[i] = EMPTY_SLOT;
+
+    rc = _sort_blocks (hash, ctx.blocks);
+    if (rc != ORHASH_SUCCESS)
+        goto exit_on_error;
+
+    /* Hashes of all-zero blocks, for the full and the last block sizes, so
+       that only the blocks that may be zeros are read */
+    zero_block = calloc (1, hash->block_size);
+    if (zero_block == NULL)
+        goto exit_on_error;
+
+    if (_orhash_hash_block (hash, zero_block, hash->block_size, zero_digest[0]) != ORHASH_SUCCESS ||
+        _orhash_hash_block (hash, zero_block, hash->last_block_size, zero_digest[1]) != ORHASH_SUCCESS)
+        goto exit_on_error;
+
+    if (_orhash_hash_data (zero_block, hash->block_size, ctx.strong_algo, zero_strong[0]) != ORHASH_SUCCESS ||
+        _orhash_hash_data (zero_block, hash->last_block_size, ctx.strong_algo, zero_strong[1]) != ORHASH_SUCCESS)
+        goto exit_on_error;
+
+    _d->num_blocks  = hash->num_blocks;
+    _d->verified    = verify;
+
+    for (i = 0; i < hash->num_blocks; i++)
+    {
+        if (memcmp (ctx.blocks[i]->hash,
+                    zero_digest[i == hash->num_blocks - 1 ? 1 : 0],
+                    ctx.digest_len) == 0 &&
+            _zero_block (&ctx, i, zero_strong))
+        {
+            _d->map[i] = ORHASH_DEDUP_ZERO_BLOCK;
+            _d->num_zero++;
+            continue;
+        }
+
+        first = _lookup_or_insert (&ctx, i);
+        _d->map[i] = first;
+        if (first == i)
+        {
+            _d->num_unique++;
+        } else {
+            _d->num_duplicates++;
+        }
+    }
+
+    if (ctx.rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "Reading blocks back from the file failed\n");
+        goto exit_on_error;
+    }
+
+    free (zero_block);
+    free (ctx.buf[0]);
+    free (ctx.buf[1]);
+    free (ctx.strongs);
+    free (ctx.strong_set);
+    free (ctx.blocks);
+    free (ctx.slots);
+
+    *dedup = _d;
+
+    return ORHASH_SUCCESS;
+
+ exit_on_error:
+    free (zero_block);
+    free (ctx.buf[0]);
+    free (ctx.buf[1]);
+    free (ctx.strongs);
+    free (ctx.strong_set);
+    free (ctx.blocks);
+    free (ctx.slots);
+    orhash_dedup_fini (&_d);
+    return ORHASH_ERROR;
+}
+
+/* Fraction of the blocks that do not need to be stored, i.e., duplicates and
+   zero blocks */
+int
+orhash_dedup_get_ratio (orhash_dedup_t *dedup, double *ratio)
+{
+    if (dedup == NULL || ratio == NULL || dedup->num_blocks == 0)
+        return ORHASH_ERR_BAD_PARAM;
+
+    *ratio = (double)(dedup->num_duplicates + dedup->num_zero) / dedup->num_blocks;
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_dedup_fini (orhash_dedup_t **dedup)
+{
+    if (dedup == NULL || *dedup == NULL)
+        return ORHASH_SUCCESS;
+
+    free ((*dedup)->map);
+    free (*dedup);
+    *dedup = NULL;
+
+    return ORHASH_SUCCESS;
+}
@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#define _GNU_SOURCE /* O_DIRECT */
+
+#include <aio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "orhash_internal.h"
+
+/* Read exactly size bytes unless the end of the file is reached first; after
+   a short read, the next one restarts from the last multiple of align read,
+   as O_DIRECT requires (align is 1 otherwise) */
+static ssize_t
+_read_full (int fd, void *buf, size_t size, off_t offset, size_t align)
+{
+    size_t  done = 0;
+    size_t  start;
+    ssize_t rc;
+
+    while (done < size)
+    {
+        start = done - done % align;
+
+        rc = pread (fd, (char*)buf + start, size - start, offset + start);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        /* Nothing new was read, the end of the file is reached */
+        if (start + rc <= done)
+            break;
+
+        done = start + rc;
+    }
+
+    return done;
+}
+
+static int
+_map_file_range (orhash_t *orhash, int fd, off_t offset, size_t length)
+{
+    off_t   map_offset;
+    long    page_size;
+
+    /* mmap() requires an offset that is a multiple of the page size */
+    page_size = sysconf (_SC_PAGESIZE);
+    map_offset = offset - (offset % page_size);
+
+    orhash->map_size = length + (offset - map_offset);
+    orhash->map_addr = mmap (NULL, orhash->map_size, PROT_READ, MAP_PRIVATE, fd, map_offset);
+    if (orhash->map_addr == MAP_FAILED)
+    {
+        orhash->map_addr = NULL;
+        orhash->map_size = 0;
+        return ORHASH_ERROR;
+    }
+
+    /* Blocks are hashed in order, let the kernel read ahead aggressively */
+    madvise (orhash->map_addr, orhash->map_size, MADV_SEQUENTIAL);
+
+    orhash->buffer = (char*)orhash->map_addr + (offset - map_offset);
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_init_file (const char        *path,
+                  off_t             offset,
+                  size_t            length,
+                  size_t            block_size,
+                  orhash_io_mode_t  io_mode,
+                  int               io_depth,
+                  orhash_t          **hash)
+{
+    int         fd;
+    int         flags;
+    int         rc;
+    struct stat st;
+    orhash_t    *_h = NULL;
+
+    if (path == NULL || hash == NULL || block_size == 0 || offset < 0)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (io_mode != ORHASH_IO_MMAP && io_mode != ORHASH_IO_PREAD && io_mode != ORHASH_IO_DIRECT)
+        return ORHASH_ERR_BAD_PARAM;
+
+    /* O_DIRECT transfers must start on an aligned offset and blocks must not
+       straddle alignment boundaries */
+    if (io_mode == ORHASH_IO_DIRECT &&
+        (offset % ORHASH_DIRECT_IO_ALIGN != 0 || block_size % ORHASH_DIRECT_IO_ALIGN != 0))
+    {
+        fprintf (stderr, "O_DIRECT requires offset and block size to be multiples of %d\n",
+                 ORHASH_DIRECT_IO_ALIGN);
+        return ORHASH_ERR_BAD_PARAM;
+    }
+
+    flags = O_RDONLY;
+    if (io_mode == ORHASH_IO_DIRECT)
+        flags |= O_DIRECT;
+
+    fd = open (path, flags);
+    if (fd < 0)
+    {
+        fprintf (stderr, "Cannot open %s\n", path);
+        return ORHASH_ERROR;
+    }
+
+    if (fstat (fd, &st) != 0)
+        goto exit_on_error;
+
+    if (offset >= st.st_size)
+        goto exit_on_error;
+
+    if (length == 0)
+        length = st.st_size - offset;
+
+    if (offset + length > st.st_size)
+    {
+        fprintf (stderr, "The requested range is beyond the end of %s\n", path);
+        goto exit_on_error;
+    }
+
+    rc = orhash_init (NULL, length, block_size, &_h);
+    if (rc != ORHASH_SUCCESS)
+        goto exit_on_error;
+
+    _h->io_mode     = io_mode;
+    _h->file_offset = offset;
+    _h->io_depth    = io_depth > 0 ? io_depth : ORHASH_DEFAULT_IO_DEPTH;
+
+    if (io_mode == ORHASH_IO_MMAP)
+    {
+        rc = _map_file_range (_h, fd, offset, length);
+        if (rc != ORHASH_SUCCESS)
+            goto exit_on_error;
+
+        /* The mapping stays valid after the file is closed */
+        close (fd);
+    } else {
+        if (io_mode == ORHASH_IO_PREAD)
+            posix_fadvise (fd, offset, length, POSIX_FADV_SEQUENTIAL);
+
+        _h->fd = fd;
+    }
+
+    *hash = _h;
+
+    return ORHASH_SUCCESS;
+
+ exit_on_error:
+    if (_h != NULL)
+        orhash_fini (&_h);
+    close (fd);
+    return ORHASH_ERROR;
+}
+
+/* A read of the ring of requests kept in flight by _orhash_file_compute_hash() */
+typedef struct read_slot_s {
+    struct aiocb    cb;
+    void            *buf;
+    size_t          first;          /* First block of the window */
+    size_t          window_size;    /* Bytes of the file in the window */
+    int             active;
+} read_slot_t;
+
+static int
+_submit_read (orhash_t *orhash, read_slot_t *slot, size_t first, size_t read_blocks)
+{
+    size_t read_size;
+
+    slot->first = first;
+    slot->window_size = orhash->buffer_size - first * orhash->block_size;
+    if (slot->window_size > read_blocks * orhash->block_size)
+        slot->window_size = read_blocks * orhash->block_size;
+
+    /* With O_DIRECT the size of the tail read also has to be aligned; the
+       read stops at the end of the file and the extra bytes are ignored */
+    read_size = slot->window_size;
+    if (orhash->io_mode == ORHASH_IO_DIRECT && read_size % ORHASH_DIRECT_IO_ALIGN != 0)
+        read_size += ORHASH_DIRECT_IO_ALIGN - (read_size % ORHASH_DIRECT_IO_ALIGN);
+
+    memset (&slot->cb, 0, sizeof (slot->cb));
+    slot->cb.aio_fildes = orhash->fd;
+    slot->cb.aio_offset = orhash->file_offset + (off_t)first * orhash->block_size;
+    slot->cb.aio_buf    = slot->buf;
+    slot->cb.aio_nbytes = read_size;
+
+    if (aio_read (&slot->cb) != 0)
+        return ORHASH_ERROR;
+
+    slot->active = 1;
+
+    return ORHASH_SUCCESS;
+}
+
+static int
+_wait_read (orhash_t *orhash, read_slot_t *slot)
+{
+    const struct aiocb  *list[1] = { &slot->cb };
+    ssize_t             n;
+    ssize_t             rest;
+    size_t              align;
+    size_t              start;
+    int                 err;
+
+    while ((err = aio_error (&slot->cb)) == EINPROGRESS)
+        aio_suspend (list, 1, NULL);
+
+    slot->active = 0;
+    n = aio_return (&slot->cb);
+    if (err != 0 || n < 0)
+        return ORHASH_ERROR;
+
+    /* Complete a short read synchronously, this is not the common case. With
+       O_DIRECT, the read restarts from the last aligned offset reached. */
+    if ((size_t)n < slot->window_size)
+    {
+        align = (orhash->io_mode == ORHASH_IO_DIRECT) ? ORHASH_DIRECT_IO_ALIGN : 1;
+        start = n - n % align;
+
+        rest = _read_full (orhash->fd,
+                           (char*)slot->buf + start,
+                           slot->cb.aio_nbytes - start,
+                           slot->cb.aio_offset + start,
+                           align);
+        if (rest < 0 || start + rest < slot->window_size)
+            return ORHASH_ERROR;
+    }
+
+    return ORHASH_SUCCESS;
+}
+
+/* Read the file with io_depth asynchronous requests in flight, each of about
+   ORHASH_FILE_READ_SIZE bytes into its own aligned buffer, and hash each
+   window as soon as it is read while the following ones are still being
+   read; the result is identical to hashing the same data in memory */
+int
+_orhash_file_compute_hash (orhash_t *orhash)
+{
+    read_slot_t *slots      = NULL;
+    size_t      read_blocks;
+    size_t      num_windows;
+    size_t      num_slots;
+    size_t      size;
+    size_t      w;
+    size_t      i;
+    int         rc;
+    blockhash_t *block_hash;
+    read_slot_t *slot;
+    char        *data;
+
+    if (orhash == NULL || orhash->fd < 0)
+        return ORHASH_ERR_BAD_PARAM;
+
+    read_blocks = ORHASH_FILE_READ_SIZE / orhash->block_size;
+    if (read_blocks == 0)
+        read_blocks = 1;
+    num_windows = (orhash->num_blocks + read_blocks - 1) / read_blocks;
+    num_slots = (size_t)orhash->io_depth < num_windows ? (size_t)orhash->io_depth : num_windows;
+
+    slots = calloc (num_slots, sizeof (read_slot_t));
+    if (slots == NULL)
+        return ORHASH_ERROR;
+
+    for (i = 0; i < num_slots; i++)
+    {
+        if (posix_memalign (&slots[i].buf, ORHASH_DIRECT_IO_ALIGN, read_blocks * orhash->block_size) != 0)
+            goto exit_on_error;
+    }
+
+    for (w = 0; w < num_slots; w++)
+    {
+        if (_submit_read (orhash, &slots[w], w * read_blocks, read_blocks) != ORHASH_SUCCESS)
+            goto exit_on_error;
+    }
+
+    for (w = 0; w < num_windows; w++)
+    {
+        slot = &slots[w % num_slots];
+
+        if (_wait_read (orhash, slot) != ORHASH_SUCCESS)
+        {
+            fprintf (stderr, "Reading the file failed\n");
+            goto exit_on_error;
+        }
+
+        for (i = slot->first; i < orhash->num_blocks && i < slot->first + read_blocks; i++)
+        {
+            block_hash = _orhash_find_block_hash (orhash, i);
+            if (block_hash == NULL)
+                goto exit_on_error;
+
+            size = (i == orhash->num_blocks - 1) ? orhash->last_block_size : orhash->block_size;
+            data = (char*)slot->buf + (i - slot->first) * orhash->block_size;
+
+            rc = _orhash_hash_block (orhash, data, size, block_hash->hash);
+            if (rc != ORHASH_SUCCESS)
+                goto exit_on_error;
+
+            _orhash_cost_update (orhash, i, data, size);
+        }
+
+        /* The buffer is free again, read the window io_depth windows ahead */
+        if (w + num_slots < num_windows)
+        {
+            rc = _submit_read (orhash, slot, (w + num_slots) * read_blocks, read_blocks);
+            if (rc != ORHASH_SUCCESS)
+                goto exit_on_error;
+        }
+    }
+
+    for (i = 0; i < num_slots; i++)
+        free (slots[i].buf);
+    free (slots);
+
+    return ORHASH_SUCCESS;
+
+ exit_on_error:
+    /* Buffers cannot be freed while the kernel may still write to them */
+    for (i = 0; slots != NULL && i < num_slots; i++)
+    {
+        if (slots[i].active)
+        {
+            aio_cancel (orhash->fd, &slots[i].cb);
+            _wait_read (orhash, &slots[i]);
+        }
+        free (slots[i].buf);
+    }
+    free (slots);
+    return ORHASH_ERROR;
+}
+
+/* Read block index of a file opened for the pread modes into buf, which must
+   hold block_size bytes aligned for O_DIRECT */
+int
+_orhash_file_read_block (orhash_t *orhash, size_t index, void *buf)
+{
+    size_t  size;
+    size_t  read_size;
+    ssize_t n;
+
+    if (orhash == NULL || orhash->fd < 0 || index >= orhash->num_blocks)
+        return ORHASH_ERR_BAD_PARAM;
+
+    size = (index == orhash->num_blocks - 1) ? orhash->last_block_size : orhash->block_size;
+
+    read_size = size;
+    if (orhash->io_mode == ORHASH_IO_DIRECT && read_size % ORHASH_DIRECT_IO_ALIGN != 0)
+        read_size += ORHASH_DIRECT_IO_ALIGN - (read_size % ORHASH_DIRECT_IO_ALIGN);
+
+    n = _read_full (orhash->fd, buf, read_size, orhash->file_offset + (off_t)index * orhash->block_size,
+                    orhash->io_mode == ORHASH_IO_DIRECT ? ORHASH_DIRECT_IO_ALIGN : 1);
+    if (n < 0 || (size_t)n < size)
+        return ORHASH_ERROR;
+
+    return ORHASH_SUCCESS;
+}
+
+void
+_orhash_file_fini (orhash_t *orhash)
+{
+    if (orhash == NULL)
+        return;
+
+    if (orhash->map_addr != NULL)
+    {
+        munmap (orhash->map_addr, orhash->map_size);
+        orhash->map_addr = NULL;
+        orhash->map_size = 0;
+        orhash->buffer = NULL;
+    }
+
+    if (orhash->fd >= 0)
+    {
+        close (orhash->fd);
+        orhash->fd = -1;
+    }
+}
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "orhash_internal.h"
+
+#define HISTORY_MAX_RATIO   (1.0 - 1e-6)    /* Saturated samples are clamped */
+#define HISTORY_SEARCH_STEPS (100)
+
+/* Dirtiness growth model: if the blocks of region r are written at random
+   with a rate lambda_r, the fraction of the region found dirty t after the
+   reference was set is 1 - exp(-lambda_r t). lambda_r is fitted by least
+   squares on -log(1 - d) = lambda_r t. Regions that are never written get a
+   rate of 0, so the model also captures the size of the working set. */
+
+static size_t
+_region_first_block (orhash_history_t *history, size_t r)
+{
+    return r * history->num_blocks / history->num_regions;
+}
+
+/* Number of bits set in [first, last) */
+static size_t
+_count_bits (const uint64_t *bitmap, size_t first, size_t last)
+{
+    size_t      n = 0;
+    size_t      w;
+    uint64_t    word;
+
+    for (w = first / 64; w * 64 < last; w++)
+    {
+        word = bitmap[w];
+        if (w * 64 < first)
+            word &= ~0ULL << (first % 64);
+        if ((w + 1) * 64 > last)
+            word &= ~0ULL >> (64 - last % 64);
+        n += __builtin_popcountll (word);
+    }
+
+    return n;
+}
+
+int
+orhash_history_init (orhash_t           *hash,
+                     size_t             capacity,
+                     size_t             num_regions,
+                     orhash_history_t   **history)
+{
+    orhash_history_t    *_h = NULL;
+    size_t              i;
+
+    if (hash == NULL || history == NULL || capacity == 0)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (num_regions == 0)
+        num_regions = 1;
+    if (num_regions > hash->num_blocks)
+        num_regions = hash->num_blocks;
+
+    _h = calloc (1, sizeof (orhash_history_t));
+    if (_h == NULL)
+        return ORHASH_ERROR;
+
+    _h->hash            = hash;
+    _h->capacity        = capacity;
+    _h->num_regions     = num_regions;
+    _h->num_blocks      = hash->num_blocks;
+    _h->times           = malloc (capacity * sizeof (double));
+    _h->ratios          = malloc (capacity * sizeof (double));
+    _h->region_ratios   = malloc (capacity * num_regions * sizeof (float));
+    _h->region_rates    = calloc (num_regions, sizeof (double));
+    _h->region_bytes    = calloc (num_regions, sizeof (double));
+    _h->bitmap          = malloc (ORHASH_BITMAP_WORDS (hash->num_blocks) * sizeof (uint64_t));
+    if (_h->times == NULL || _h->ratios == NULL || _h->region_ratios == NULL ||
+        _h->region_rates == NULL || _h->region_bytes == NULL || _h->bitmap == NULL)
+        goto exit_on_error;
+
+    for (i = 0; i < num_regions; i++)
+    {
+        _h->region_bytes[i] = (double)(_region_first_block (_h, i + 1) - _region_first_block (_h, i)) *
+                              hash->block_size;
+    }
+    _h->region_bytes[num_regions - 1] -= hash->block_size - hash->last_block_size;
+
+    *history = _h;
+
+    return ORHASH_SUCCESS;
+
+ exit_on_error:
+    orhash_history_fini (&_h);
+    return ORHASH_ERROR;
+}
+
+int
+orhash_history_record (orhash_history_t *history, double elapsed)
+{
+    orhash_t    *hash;
+    size_t      num_dirty;
+    size_t      r;
+    size_t      first;
+    size_t      last;
+    float       *region_ratios;
+    int         rc;
+
+    if (history == NULL || elapsed < 0.0)
+        return ORHASH_ERR_BAD_PARAM;
+
+    hash = history->hash;
+    if (hash->num_blocks != history->num_blocks)
+    {
+        fprintf (stderr, "The number of blocks changed since the history was created\n");
+        return ORHASH_ERR_BAD_PARAM;
+    }
+
+    rc = orhash_get_dirty_blocks (hash, history->bitmap, &num_dirty);
+    if (rc != ORHASH_SUCCESS)
+        return rc;
+
+    /* The oldest sample is overwritten once the ring is full */
+    history->times[history->next] = elapsed;
+    history->ratios[history->next] = (double)num_dirty / hash->num_blocks;
+
+    region_ratios = history->region_ratios + history->next * history->num_regions;
+    for (r = 0; r < history->num_regions; r++)
+    {
+        first = _region_first_block (history, r);
+        last = _region_first_block (history, r + 1);
+        region_ratios[r] = (float)_count_bits (history->bitmap, first, last) / (last - first);
+    }
+
+    history->next = (history->next + 1) % history->capacity;
+    if (history->num_samples < history->capacity)
+        history->num_samples++;
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_history_fit (orhash_history_t *history)
+{
+    size_t  r;
+    size_t  s;
+    size_t  n_used = 0;
+    double  sum_tt;
+    double  sum_ty;
+    double  d;
+    double  t;
+
+    if (history == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    for (r = 0; r < history->num_regions; r++)
+    {
+        sum_tt = 0.0;
+        sum_ty = 0.0;
+
+        for (s = 0; s < history->num_samples; s++)
+        {
+            t = history->times[s];
+            if (t <= 0.0)
+                continue;
+
+            d = history->region_ratios[s * history->num_regions + r];
+            if (d > HISTORY_MAX_RATIO)
+                d = HISTORY_MAX_RATIO;
+
+            sum_tt += t * t;
+            sum_ty += t * -log (1.0 - d);
+        }
+
+        if (sum_tt == 0.0)
+            break;
+
+        history->region_rates[r] = sum_ty / sum_tt;
+        n_used++;
+    }
+
+    if (n_used == 0)
+    {
+        fprintf (stderr, "No sample taken after the reference to fit\n");
+        return ORHASH_ERROR;
+    }
+
+    history->fitted = 1;
+
+    return ORHASH_SUCCESS;
+}
+
+/* Bytes expected to be dirty elapsed after the reference; with the cost
+   model, each region is weighted by its estimated compressed size */
+static double
+_predict_bytes (orhash_history_t *history, double elapsed, double *ratio)
+{
+    double  dirty_bytes = 0.0;
+    double  dirty_blocks = 0.0;
+    double  d;
+    size_t  r;
+
+    for (r = 0; r < history->num_regions; r++)
+    {
+        d = 1.0 - exp (-history->region_rates[r] * elapsed);
+        dirty_bytes += d * history->region_bytes[r];
+        dirty_blocks += d * (_region_first_block (history, r + 1) - _region_first_block (history, r));
+    }
+
+    if (ratio != NULL)
+        *ratio = dirty_blocks / history->num_blocks;
+
+    return dirty_bytes;
+}
+
+int
+orhash_history_predict (orhash_history_t *history, double elapsed, double *ratio)
+{
+    if (history == NULL || ratio == NULL || elapsed < 0.0 || !history->fitted)
+        return ORHASH_ERR_BAD_PARAM;
+
+    _predict_bytes (history, elapsed, ratio);
+
+    return ORHASH_SUCCESS;
+}
+
+static void
+_update_region_bytes (orhash_history_t *history)
+{
+    orhash_t    *hash = history->hash;
+    size_t      r;
+    size_t      i;
+    size_t      size;
+
+    if (hash->cost_ratio == NULL)
+        return;
+
+    /* Without block shifts (not supported with the cost model), the blocks
+       of a region are stored and estimated in the same order */
+    for (r = 0; r < history->num_regions; r++)
+    {
+        history->region_bytes[r] = 0.0;
+        for (i = _region_first_block (history, r); i < _region_first_block (history, r + 1); i++)
+        {
+            size = (i == hash->num_blocks - 1) ? hash->last_block_size : hash->block_size;
+            history->region_bytes[r] += size * hash->cost_ratio[i];
+        }
+    }
+}
+
+/* Fraction of the time lost with checkpoints every interval: the time to
+   write the checkpoint, plus on average half an interval of work redone
+   after each failure */
+static double
+_waste (orhash_history_t *history, const orhash_ckpt_params_t *params, double interval)
+{
+    double cost = params->latency + _predict_bytes (history, interval, NULL) / params->write_bandwidth;
+
+    return cost / interval + interval * params->failure_rate / 2.0;
+}
+
+int
+orhash_history_suggest_interval (orhash_history_t               *history,
+                                 const orhash_ckpt_params_t     *params,
+                                 double                         *interval,
+                                 double                         *ratio)
+{
+    const double    phi = (sqrt (5.0) - 1.0) / 2.0;
+    double          full_cost;
+    double          lo;
+    double          hi;
+    double          a;
+    double          b;
+    double          wa;
+    double          wb;
+    size_t          r;
+    int             i;
+
+    if (history == NULL || params == NULL || interval == NULL || !history->fitted ||
+        params->write_bandwidth <= 0.0 || params->failure_rate <= 0.0 || params->latency < 0.0)
+        return ORHASH_ERR_BAD_PARAM;
+
+    _update_region_bytes (history);
+
+    /* The checkpoint cost C(T) grows with the interval T but T C'(T) < C(T),
+       so the optimum, where T^2 = 2 (C(T) - T C'(T)) / failure_rate, lies
+       between Young's interval for the latency only and for a full
+       checkpoint */
+    full_cost = params->latency;
+    for (r = 0; r < history->num_regions; r++)
+        full_cost += history->region_bytes[r] / params->write_bandwidth;
+
+    hi = sqrt (2.0 * full_cost / params->failure_rate);
+    lo = sqrt (2.0 * params->latency / params->failure_rate);
+    if (lo <= 0.0)
+        lo = hi * 1e-9;
+
+    /* Golden section search of the minimum waste */
+    a = hi - phi * (hi - lo);
+    b = lo + phi * (hi - lo);
+    wa = _waste (history, params, a);
+    wb = _waste (history, params, b);
+    for (i = 0; i < HISTORY_SEARCH_STEPS && hi - lo > 1e-9 * hi; i++)
+    {
+        if (wa < wb)
+        {
+            hi = b;
+            b = a;
+            wb = wa;
+            a = hi - phi * (hi - lo);
+            wa = _waste (history, params, a);
+        } else {
+            lo = a;
+            a = b;
+            wa = wb;
+            b = lo + phi * (hi - lo);
+            wb = _waste (history, params, b);
+        }
+    }
+
+    *interval = (lo + hi) / 2.0;
+    if (ratio != NULL)
+        _predict_bytes (history, *interval, ratio);
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_history_fini (orhash_history_t **history)
+{
+    if (history == NULL || *history == NULL)
+        return ORHASH_SUCCESS;
+
+    free ((*history)->times);
+    free ((*history)->ratios);
+    free ((*history)->region_ratios);
+    free ((*history)->region_rates);
+    free ((*history)->region_bytes);
+    free ((*history)->bitmap);
+    free (*history);
+    *history = NULL;
+
+    return ORHASH_SUCCESS;
+}
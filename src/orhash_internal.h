@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#ifndef SRC_ORHASH_INTERNAL_H
+#define SRC_ORHASH_INTERNAL_H
+
+#include "orhash.h"
+
+/* Functions shared between the source files of the library; not part of the API */
+
+blockhash_t *
+_orhash_find_block_hash (orhash_t *orhash, long index);
+
+blockhash_t *
+_orhash_find_block_refhash (orhash_t *orhash, long index);
+
+int
+_orhash_hash_data (void *ptr, size_t size, hashid algo, unsigned char *digest);
+
+int
+_orhash_hash_block (orhash_t *orhash, void *ptr, size_t size, unsigned char *digest);
+
+int
+_orhash_is_zero (const void *ptr, size_t size);
+
+void *
+_orhash_tolerance_apply (orhash_t *orhash, void *ptr, size_t size, size_t *out_size);
+
+void
+_orhash_cost_update (orhash_t *orhash, size_t index, void *ptr, size_t size);
+
+void
+_orhash_init_fields (orhash_t *h, void *buffer, size_t buffer_size, size_t block_size);
+
+int
+_orhash_sparse_compute_hash (orhash_t *orhash);
+
+int
+_orhash_sparse_set_ref_hash (orhash_t *orhash);
+
+int
+_orhash_sparse_get_dirty_blocks (orhash_t *orhash, uint64_t *bitmap, size_t *num_dirty);
+
+void
+_orhash_sparse_fini (orhash_t *orhash);
+
+int
+_orhash_concurrent_compute_hash (orhash_t *orhash);
+
+void
+_orhash_concurrent_fini (orhash_t *orhash);
+
+int
+_orhash_file_compute_hash (orhash_t *orhash);
+
+int
+_orhash_file_read_block (orhash_t *orhash, size_t index, void *buf);
+
+void
+_orhash_file_fini (orhash_t *orhash);
+
+#endif /* SRC_ORHASH_INTERNAL_H */
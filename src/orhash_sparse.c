@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+
+#include "orhash_internal.h"
+
+#define SPARSE_TOUCHED  (1 << 0)    /* May have been written since hashed */
+#define SPARSE_ZERO     (1 << 1)    /* Only held zeros when last hashed */
+
+/* A sparse hash splits the buffer in regions of sparse_region_blocks blocks.
+   A region only gets storage for its block hashes once it is hashed with
+   data other than zeros; until then, both its block hashes and reference
+   hashes are the ones of blocks of zeros. Regions that only hold zeros in
+   both the data and the reference release their storage when the reference
+   is set. The region size is a multiple of 64 so that regions start on a word
+   of the dirty bitmap. */
+
+static size_t
+_region_num_blocks (orhash_t *orhash, size_t r)
+{
+    size_t first = r * orhash->sparse_region_blocks;
+
+    if (orhash->num_blocks - first < orhash->sparse_region_blocks)
+        return orhash->num_blocks - first;
+
+    return orhash->sparse_region_blocks;
+}
+
+int
+orhash_init_sparse (void        *buffer,
+                    size_t      buffer_size,
+                    size_t      block_size,
+                    size_t      region_blocks,
+                    orhash_t    **hash)
+{
+    orhash_t    *_h;
+
+    if (buffer == NULL || buffer_size == 0 || block_size == 0 || hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (region_blocks == 0)
+        region_blocks = ORHASH_DEFAULT_SPARSE_REGION_BLOCKS;
+    region_blocks = (region_blocks + 63) / 64 * 64;
+
+    _h = malloc (sizeof (orhash_t));
+    if (_h == NULL)
+        return ORHASH_ERROR;
+
+    _orhash_init_fields (_h, buffer, buffer_size, block_size);
+
+    _h->sparse_region_blocks    = region_blocks;
+    _h->num_sparse_regions      = (_h->num_blocks + region_blocks - 1) / region_blocks;
+    _h->sparse_digests          = calloc (_h->num_sparse_regions, sizeof (unsigned char*));
+    _h->sparse_flags            = calloc (_h->num_sparse_regions, sizeof (unsigned char));
+    _h->sparse_scratch          = malloc (region_blocks * _h->digest_len);
+    if (_h->sparse_digests == NULL || _h->sparse_flags == NULL || _h->sparse_scratch == NULL)
+    {
+        orhash_fini (&_h);
+        return ORHASH_ERROR;
+    }
+
+    *hash = _h;
+
+    return ORHASH_SUCCESS;
+}
+
+int
+orhash_sparse_touch (orhash_t *hash, size_t offset, size_t length)
+{
+    size_t  first;
+    size_t  last;
+    size_t  r;
+
+    if (hash == NULL || hash->sparse_digests == NULL || length == 0 ||
+        offset >= hash->buffer_size || length > hash->buffer_size - offset)
+        return ORHASH_ERR_BAD_PARAM;
+
+    first = offset / hash->block_size / hash->sparse_region_blocks;
+    last = (offset + length - 1) / hash->block_size / hash->sparse_region_blocks;
+
+    for (r = first; r <= last; r++)
+        hash->sparse_flags[r] |= SPARSE_TOUCHED;
+
+    return ORHASH_SUCCESS;
+}
+
+/* Hash the blocks of region r into digests and tell whether the region only
+   holds zeros */
+static int
+_hash_region (orhash_t          *orhash,
+              size_t            r,
+              unsigned char     *digests,
+              unsigned char     zero_digest[2][HASH_LEN],
+              int               *zero)
+{
+    size_t          n = _region_num_blocks (orhash, r);
+    size_t          block;
+    size_t          size;
+    size_t          j;
+    void            *ptr;
+    unsigned char   *digest;
+    unsigned char   *zd;
+
+    *zero = 1;
+
+    for (j = 0; j < n; j++)
+    {
+        block = r * orhash->sparse_region_blocks + j;
+        size = (block == orhash->num_blocks - 1) ? orhash->last_block_size : orhash->block_size;
+        ptr = (char*)orhash->buffer + block * orhash->block_size;
+        digest = digests + j * orhash->digest_len;
+        zd = zero_digest[block == orhash->num_blocks - 1];
+
+        if (_orhash_hash_block (orhash, ptr, size, digest) != ORHASH_SUCCESS)
+            return ORHASH_ERROR;
+
+        /* The data is only checked when the hash says it may be zeros */
+        if (*zero && (memcmp (digest, zd, orhash->digest_len) != 0 || !_orhash_is_zero (ptr, size)))
+            *zero = 0;
+    }
+
+    return ORHASH_SUCCESS;
+}
+
+static int
+_alloc_region (orhash_t *orhash, size_t r, unsigned char zero_digest[2][HASH_LEN])
+{
+    size_t          n = _region_num_blocks (orhash, r);
+    size_t          region_len = orhash->sparse_region_blocks * orhash->digest_len;
+    size_t          block;
+    size_t          j;
+    unsigned char   *d;
+
+    d = malloc (2 * region_len);
+    if (d == NULL)
+        return ORHASH_ERROR;
+
+    /* Until now the region was zeros, for the reference as well */
+    for (j = 0; j < n; j++)
+    {
+        block = r * orhash->sparse_region_blocks + j;
+        memcpy (d + region_len + j * orhash->digest_len,
+                zero_digest[block == orhash->num_blocks - 1],
+                orhash->digest_len);
+    }
+
+    orhash->sparse_digests[r] = d;
+    orhash->num_sparse_allocated++;
+
+    return ORHASH_SUCCESS;
+}
+
+int
+_orhash_sparse_compute_hash (orhash_t *orhash)
+{
+    unsigned char   zero_digest[2][HASH_LEN];
+    void            *zero_block;
+    size_t          region_len = orhash->sparse_region_blocks * orhash->digest_len;
+    size_t          r;
+    int             zero;
+    int             rc;
+
+    /* Hashes of blocks of zeros, after the tolerance if any, for the regions
+       without storage */
+    zero_block = calloc (1, orhash->block_size);
+    if (zero_block == NULL)
+        return ORHASH_ERROR;
+
+    rc = _orhash_hash_block (orhash, zero_block, orhash->block_size, zero_digest[0]);
+    if (rc == ORHASH_SUCCESS)
+        rc = _orhash_hash_block (orhash, zero_block, orhash->last_block_size, zero_digest[1]);
+    free (zero_block);
+    if (rc != ORHASH_SUCCESS)
+        return ORHASH_ERROR;
+
+    for (r = 0; r < orhash->num_sparse_regions; r++)
+    {
+        if (orhash->sparse_digests[r] == NULL && !(orhash->sparse_flags[r] & SPARSE_TOUCHED))
+            continue;
+
+        if (orhash->sparse_digests[r] != NULL)
+        {
+            rc = _hash_region (orhash, r, orhash->sparse_digests[r], zero_digest, &zero);
+            if (rc != ORHASH_SUCCESS)
+                return ORHASH_ERROR;
+        } else {
+            /* Regions touched but still only holding zeros get no storage */
+            rc = _hash_region (orhash, r, orhash->sparse_scratch, zero_digest, &zero);
+            if (rc != ORHASH_SUCCESS)
+                return ORHASH_ERROR;
+
+            if (!zero)
+            {
+                if (_alloc_region (orhash, r, zero_digest) != ORHASH_SUCCESS)
+                    return ORHASH_ERROR;
+
+                memcpy (orhash->sparse_digests[r], orhash->sparse_scratch, region_len);
+            }
+        }
+
+        orhash->sparse_flags[r] = zero ? SPARSE_ZERO : 0;
+    }
+
+    return ORHASH_SUCCESS;
+}
+
+int
+_orhash_sparse_set_ref_hash (orhash_t *orhash)
+{
+    size_t  region_len = orhash->sparse_region_blocks * orhash->digest_len;
+    size_t  r;
+
+    for (r = 0; r < orhash->num_sparse_regions; r++)
+    {
+        if (orhash->sparse_digests[r] == NULL)
+            continue;
+
+        /* Zeros now and in the reference, the same as no storage */
+        if (orhash->sparse_flags[r] & SPARSE_ZERO)
+        {
+            free (orhash->sparse_digests[r]);
+            orhash->sparse_digests[r] = NULL;
+            orhash->sparse_flags[r] &= ~SPARSE_ZERO;
+            orhash->num_sparse_allocated--;
+            continue;
+        }
+
+        memcpy (orhash->sparse_digests[r] + region_len, orhash->sparse_digests[r], region_len);
+    }
+
+    return ORHASH_SUCCESS;
+}
+
+int
+_orhash_sparse_get_dirty_blocks (orhash_t *orhash, uint64_t *bitmap, size_t *num_dirty)
+{
+    size_t  region_len = orhash->sparse_region_blocks * orhash->digest_len;
+    size_t  words = orhash->sparse_region_blocks / 64;
+    size_t  n_differ = 0;
+    size_t  n;
+    size_t  r;
+
+    for (r = 0; r < orhash->num_sparse_regions; r++)
+    {
+        n = _region_num_blocks (orhash, r);
+
+        if (orhash->sparse_digests[r] == NULL)
+        {
+            if (bitmap != NULL)
+                memset (bitmap + r * words, 0, ORHASH_BITMAP_WORDS (n) * sizeof (uint64_t));
+            continue;
+        }
+
+        n_differ += orhash_compare_digests (orhash->sparse_digests[r],
+                                            orhash->sparse_digests[r] + region_len,
+                                            n,
+                                            orhash->digest_len,
+                                            bitmap != NULL ? bitmap + r * words : NULL);
+    }
+
+    *num_dirty = n_differ;
+
+    return ORHASH_SUCCESS;
+}
+
+void
+_orhash_sparse_fini (orhash_t *orhash)
+{
+    size_t r;
+
+    if (orhash == NULL)
+        return;
+
+    for (r = 0; orhash->sparse_digests != NULL && r < orhash->num_sparse_regions; r++)
+        free (orhash->sparse_digests[r]);
+
+    free (orhash->sparse_digests);
+    orhash->sparse_digests = NULL;
+    free (orhash->sparse_flags);
+    orhash->sparse_flags = NULL;
+    free (orhash->sparse_scratch);
+    orhash->sparse_scratch = NULL;
+    orhash->num_sparse_allocated = 0;
+}
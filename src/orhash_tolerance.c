@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "orhash_internal.h"
+
+#define FLOAT_MANTISSA_BITS     (23)
+#define DOUBLE_MANTISSA_BITS    (52)
+
+/* The kernels below process vectors of doubles with SSE2, SSE4.1 or AVX when
+   the library is built for them, then the remaining elements with the scalar
+   code, which gives the same results. Floats and 32-bit integers are
+   quantized as doubles, as the scalar code does. */
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define TOL_SIMD
+#endif
+
+#if defined(__AVX__)
+typedef __m256d vec_pd_t;
+#define VEC_PD_LEN              (4)
+#define _vec_set1(d)            _mm256_set1_pd (d)
+#define _vec_mul(a, b)          _mm256_mul_pd (a, b)
+#define _vec_add(a, b)          _mm256_add_pd (a, b)
+#define _vec_floor(v)           _mm256_floor_pd (v)
+#define _vec_load_pd(p)         _mm256_loadu_pd (p)
+#define _vec_store_pd(p, v)     _mm256_storeu_pd (p, v)
+#define _vec_load_ps(p)         _mm256_cvtps_pd (_mm_loadu_ps (p))
+#define _vec_store_ps(p, v)     _mm_storeu_ps (p, _mm256_cvtpd_ps (v))
+#define _vec_load_epi32(p)      _mm256_cvtepi32_pd (_mm_loadu_si128 ((const __m128i*)(p)))
+#elif defined(TOL_SIMD)
+typedef __m128d vec_pd_t;
+#define VEC_PD_LEN              (2)
+#define _vec_set1(d)            _mm_set1_pd (d)
+#define _vec_mul(a, b)          _mm_mul_pd (a, b)
+#define _vec_add(a, b)          _mm_add_pd (a, b)
+#define _vec_load_pd(p)         _mm_loadu_pd (p)
+#define _vec_store_pd(p, v)     _mm_storeu_pd (p, v)
+#define _vec_load_ps(p)         _mm_cvtps_pd (_mm_castsi128_ps (_mm_loadl_epi64 ((const __m128i*)(p))))
+#define _vec_store_ps(p, v)     _mm_storel_epi64 ((__m128i*)(p), _mm_castps_si128 (_mm_cvtpd_ps (v)))
+#define _vec_load_epi32(p)      _mm_cvtepi32_pd (_mm_loadl_epi64 ((const __m128i*)(p)))
+#if defined(__SSE4_1__)
+#define _vec_floor(v)           _mm_floor_pd (v)
+#else
+/* SSE2 has no floor: adding and subtracting 2^52 with the sign of x rounds
+   x to an integer, which is then corrected when it is above x. Values of
+   magnitude 2^52 or more, infinities and NaNs are kept as they are. */
+static inline __m128d
+_vec_floor (__m128d x)
+{
+    const __m128d   two52   = _mm_set1_pd (4503599627370496.0);
+    const __m128d   sign    = _mm_set1_pd (-0.0);
+    __m128d         m;
+    __m128d         r;
+    __m128d         small;
+
+    m = _mm_or_pd (two52, _mm_and_pd (sign, x));
+    r = _mm_sub_pd (_mm_add_pd (x, m), m);
+    r = _mm_sub_pd (r, _mm_and_pd (_mm_cmpgt_pd (r, x), _mm_set1_pd (1.0)));
+    small = _mm_cmplt_pd (_mm_andnot_pd (sign, x), two52);
+
+    return _mm_or_pd (_mm_and_pd (small, r), _mm_andnot_pd (small, x));
+}
+#endif
+#endif
+
+static void
+_quantize_double (const double *restrict in, double *restrict out, size_t n, double scale)
+{
+    size_t i = 0;
+
+#if defined(TOL_SIMD)
+    vec_pd_t s = _vec_set1 (scale);
+    vec_pd_t z = _vec_set1 (0.0);
+
+    for (; i + VEC_PD_LEN <= n; i += VEC_PD_LEN)
+        _vec_store_pd (out + i, _vec_add (_vec_floor (_vec_mul (_vec_load_pd (in + i), s)), z));
+#endif
+
+    /* Adding 0.0 turns -0.0 into 0.0 so both have the same representation */
+    for (; i < n; i++)
+        out[i] = floor (in[i] * scale) + 0.0;
+}
+
+static void
+_quantize_float (const float *restrict in, float *restrict out, size_t n, double scale)
+{
+    size_t i = 0;
+
+#if defined(TOL_SIMD)
+    vec_pd_t s = _vec_set1 (scale);
+    vec_pd_t z = _vec_set1 (0.0);
+
+    for (; i + VEC_PD_LEN <= n; i += VEC_PD_LEN)
+        _vec_store_ps (out + i, _vec_add (_vec_floor (_vec_mul (_vec_load_ps (in + i), s)), z));
+#endif
+
+    for (; i < n; i++)
+        out[i] = (float)(floor (in[i] * scale) + 0.0);
+}
+
+static void
+_quantize_int32 (const int32_t *restrict in, double *restrict out, size_t n, double scale)
+{
+    size_t i = 0;
+
+#if defined(TOL_SIMD)
+    vec_pd_t s = _vec_set1 (scale);
+    vec_pd_t z = _vec_set1 (0.0);
+
+    for (; i + VEC_PD_LEN <= n; i += VEC_PD_LEN)
+        _vec_store_pd (out + i, _vec_add (_vec_floor (_vec_mul (_vec_load_epi32 (in + i), s)), z));
+#endif
+
+    /* Exact for 32-bit integers */
+    for (; i < n; i++)
+        out[i] = floor (in[i] * scale) + 0.0;
+}
+
+/* There is no SIMD division of 64-bit integers; quanta that are powers of
+   two, the common case, are applied with a shift, which the compiler can
+   vectorize, instead of a division */
+static void
+_quantize_int64 (const int64_t *restrict in, int64_t *restrict out, size_t n, long quantum)
+{
+    size_t  i;
+    int64_t r;
+    int     shift;
+
+    if ((quantum & (quantum - 1)) == 0)
+    {
+        shift = __builtin_ctzl (quantum);
+
+        /* Arithmetic shifts round towards minus infinity as well */
+        for (i = 0; i < n; i++)
+            out[i] = in[i] >> shift;
+
+        return;
+    }
+
+    /* Rounding towards minus infinity so that all the buckets have the same size */
+    for (i = 0; i < n; i++)
+    {
+        r = in[i] % quantum;
+        out[i] = (in[i] - r) / quantum - (r < 0);
+    }
+}
+
+static void
+_truncate_32 (const uint32_t *restrict in, uint32_t *restrict out, size_t n, uint32_t mask)
+{
+    size_t i = 0;
+
+#if defined(TOL_SIMD)
+    __m128i m = _mm_set1_epi32 ((int32_t)mask);
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128 ((__m128i*)(out + i), _mm_and_si128 (_mm_loadu_si128 ((const __m128i*)(in + i)), m));
+#endif
+
+    for (; i < n; i++)
+        out[i] = in[i] & mask;
+}
+
+static void
+_truncate_64 (const uint64_t *restrict in, uint64_t *restrict out, size_t n, uint64_t mask)
+{
+    size_t i = 0;
+
+#if defined(TOL_SIMD)
+    __m128i m = _mm_set1_epi64x ((int64_t)mask);
+
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_si128 ((__m128i*)(out + i), _mm_and_si128 (_mm_loadu_si128 ((const __m128i*)(in + i)), m));
+#endif
+
+    for (; i < n; i++)
+        out[i] = in[i] & mask;
+}
+
+static size_t
+_elem_size (orhash_elem_type_t elem_type)
+{
+    switch (elem_type)
+    {
+        case ORHASH_TYPE_FLOAT:
+        case ORHASH_TYPE_INT32:
+            return 4;
+        case ORHASH_TYPE_DOUBLE:
+        case ORHASH_TYPE_INT64:
+            return 8;
+        default:
+            return 1;
+    }
+}
+
+int
+orhash_set_tolerance (orhash_t              *hash,
+                      orhash_elem_type_t    elem_type,
+                      orhash_tol_mode_t     tol_mode,
+                      double                tolerance)
+{
+    size_t  elem_size;
+    int     mantissa_bits;
+    int     kept_bits;
+
+    if (hash == NULL)
+        return ORHASH_ERR_BAD_PARAM;
+
+    if (elem_type == ORHASH_TYPE_RAW || tol_mode == ORHASH_TOL_NONE)
+    {
+        free (hash->tol_scratch);
+        hash->tol_scratch   = NULL;
+        hash->elem_type     = ORHASH_TYPE_RAW;
+        hash->tol_mode      = ORHASH_TOL_NONE;
+        hash->tolerance     = 0.0;
+        return ORHASH_SUCCESS;
+    }
+
+    if (!(tolerance > 0.0))
+        return ORHASH_ERR_BAD_PARAM;
+
+    /* An element must never be split between two blocks */
+    elem_size = _elem_size (elem_type);
+    if (hash->block_size % elem_size != 0 || hash->buffer_size % elem_size != 0)
+    {
+        fprintf (stderr, "Block and buffer sizes must be multiples of the element size\n");
+        return ORHASH_ERR_BAD_PARAM;
+    }
+
+    if (tol_mode == ORHASH_TOL_RELATIVE)
+    {
+        if (elem_type != ORHASH_TYPE_FLOAT && elem_type != ORHASH_TYPE_DOUBLE)
+        {
+            fprintf (stderr, "Relative tolerances are only supported for floating-point types\n");
+            return ORHASH_ERR_BAD_PARAM;
+        }
+
+        /* Keeping k mantissa bits bounds the relative error by 2^-k */
+        mantissa_bits = (elem_type == ORHASH_TYPE_FLOAT) ? FLOAT_MANTISSA_BITS : DOUBLE_MANTISSA_BITS;
+        kept_bits = (int) ceil (-log2 (tolerance));
+        if (kept_bits < 0)
+            kept_bits = 0;
+        if (kept_bits > mantissa_bits)
+            kept_bits = mantissa_bits;
+
+        hash->tol_mask = ~((UINT64_C(1) << (mantissa_bits - kept_bits)) - 1);
+    } else if (tol_mode == ORHASH_TOL_ABSOLUTE) {
+        if (elem_type == ORHASH_TYPE_INT64 && tolerance < 1.0)
+            return ORHASH_ERR_BAD_PARAM;
+
+        hash->tol_scale     = 1.0 / tolerance;
+        hash->tol_quantum   = (long) tolerance;
+    } else {
+        return ORHASH_ERR_BAD_PARAM;
+    }
+
+    /* Quantized 32-bit integers are stored as doubles */
+    free (hash->tol_scratch);
+    hash->tol_scratch = malloc (hash->block_size * 2);
+    if (hash->tol_scratch == NULL)
+        return ORHASH_ERROR;
+
+    hash->elem_type = elem_type;
+    hash->tol_mode  = tol_mode;
+    hash->tolerance = tolerance;
+
+    return ORHASH_SUCCESS;
+}
+
+/* Transform a block of elements into their tolerance-insensitive representation;
+   size is the size of the block in bytes, the result is returned with its size */
+void *
+_orhash_tolerance_apply (orhash_t *orhash, void *ptr, size_t size, size_t *out_size)
+{
+    size_t  n;
+
+    n = size / _elem_size (orhash->elem_type);
+    *out_size = size;
+
+    if (orhash->tol_mode == ORHASH_TOL_RELATIVE)
+    {
+        if (orhash->elem_type == ORHASH_TYPE_FLOAT)
+        {
+            _truncate_32 (ptr, orhash->tol_scratch, n, (uint32_t) orhash->tol_mask);
+        } else {
+            _truncate_64 (ptr, orhash->tol_scratch, n, orhash->tol_mask);
+        }
+
+        return orhash->tol_scratch;
+    }
+
+    switch (orhash->elem_type)
+    {
+        case ORHASH_TYPE_FLOAT:
+            _quantize_float (ptr, orhash->tol_scratch, n, orhash->tol_scale);
+            break;
+        case ORHASH_TYPE_DOUBLE:
+            _quantize_double (ptr, orhash->tol_scratch, n, orhash->tol_scale);
+            break;
+        case ORHASH_TYPE_INT32:
+            _quantize_int32 (ptr, orhash->tol_scratch, n, orhash->tol_scale);
+            *out_size = n * sizeof (double);
+            break;
+        case ORHASH_TYPE_INT64:
+            _quantize_int64 (ptr, orhash->tol_scratch, n, orhash->tol_quantum);
+            break;
+        default:
+            return ptr;
+    }
+
+    return orhash->tol_scratch;
+}
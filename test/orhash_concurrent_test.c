@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <unistd.h>
+
+#include "orhash.h"
+
+#define ARRAY_SIZE  (1 << 18)
+#define BLOCK_SIZE  (4096)
+#define NUM_WRITES  (100000)
+
+typedef struct writer_arg_s {
+    orhash_t    *hash;
+    double      *array;
+} writer_arg_t;
+
+/* Application thread writing the buffer while it is hashed */
+static void *
+_writer (void *arg)
+{
+    writer_arg_t    *w = arg;
+    size_t          idx;
+    int             i;
+
+    for (i = 0; i < NUM_WRITES; i++)
+    {
+        idx = ((size_t)i * 7919) % ARRAY_SIZE;
+
+        orhash_write_begin (w->hash, idx * sizeof (double), sizeof (double));
+        w->array[idx] += 1.0;
+        orhash_write_end (w->hash, idx * sizeof (double), sizeof (double));
+    }
+
+    return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+    int             rc;
+    double          *array  = NULL;
+    orhash_t        *hash   = NULL;
+    pthread_t       thread;
+    writer_arg_t    w;
+    double          ratio;
+    double          *shifted        = NULL;
+    orhash_t        *shifted_hash   = NULL;
+
+    array = calloc (ARRAY_SIZE, sizeof (double));
+    if (array == NULL)
+        return EXIT_FAILURE;
+
+    rc = orhash_init (array, ARRAY_SIZE * sizeof (double), BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_concurrent (hash, 1);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_concurrent() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* A write in progress makes the block dirty even if the data is unchanged */
+    orhash_write_begin (hash, 3 * BLOCK_SIZE, 1);
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio: %.6f\n", ratio);
+    if (ratio != 1.0 / hash->num_blocks)
+    {
+        fprintf (stderr, "ERROR: only the block being written should be dirty\n");
+        goto exit_on_failure;
+    }
+
+    orhash_write_end (hash, 3 * BLOCK_SIZE, 1);
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio: %.6f\n", ratio);
+    if (ratio != 0.0)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 0\n");
+        goto exit_on_failure;
+    }
+
+    /* A block with a write in progress for the whole background computation
+       is dirty */
+    orhash_write_begin (hash, 5 * BLOCK_SIZE, sizeof (double));
+
+    rc = orhash_compute_hash_start (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash_start() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    array[5 * BLOCK_SIZE / sizeof (double)] = 1.0;
+
+    rc = orhash_compute_hash_wait (hash);
+    orhash_write_end (hash, 5 * BLOCK_SIZE, sizeof (double));
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash_wait() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio: %.6f\n", ratio);
+    if (ratio != 1.0 / hash->num_blocks)
+    {
+        fprintf (stderr, "ERROR: the block written during the computation should be dirty\n");
+        goto exit_on_failure;
+    }
+
+    /* A block written and restored after the hasher went past it, but before
+       the computation ends, is dirty as well: all the blocks written during
+       the computation are */
+    rc = orhash_compute_hash (hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_set_ref_hash (hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_compute_hash_start (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: cannot start the computation (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Give the hasher time to go past block 0; the block is dirty anyway */
+    usleep (10000);
+
+    orhash_write_begin (hash, 0, sizeof (double));
+    array[0] += 1.0;
+    array[0] -= 1.0;
+    orhash_write_end (hash, 0, sizeof (double));
+
+    rc = orhash_compute_hash_wait (hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: the background computation failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio: %.6f\n", ratio);
+    if (ratio != 1.0 / hash->num_blocks)
+    {
+        fprintf (stderr, "ERROR: the block written after it was hashed should be dirty\n");
+        goto exit_on_failure;
+    }
+
+    /* Shifted blocks are not stored in the order of the buffer anymore */
+    shifted = calloc (ARRAY_SIZE, sizeof (double));
+    if (shifted == NULL)
+        goto exit_on_failure;
+
+    rc = orhash_init (shifted, ARRAY_SIZE * sizeof (double), BLOCK_SIZE, &shifted_hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_reinit (shifted_hash, shifted, ARRAY_SIZE * sizeof (double), -1);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: cannot shift the blocks (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_concurrent (shifted_hash, 1);
+    if (rc != ORHASH_ERROR)
+    {
+        fprintf (stderr, "ERROR: orhash_set_concurrent() should fail on shifted blocks\n");
+        goto exit_on_failure;
+    }
+
+    orhash_fini (&shifted_hash);
+    free (shifted);
+    shifted = NULL;
+
+    /* Hash in the background while another thread keeps writing */
+    w.hash = hash;
+    w.array = array;
+    if (pthread_create (&thread, NULL, _writer, &w) != 0)
+        goto exit_on_failure;
+
+    rc = orhash_compute_hash_start (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash_start() failed (line: %d)\n", __LINE__);
+        pthread_join (thread, NULL);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash_wait (hash);
+    pthread_join (thread, NULL);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash_wait() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Once the writer is done, a new pass sees all the modified blocks */
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio: %.6f\n", ratio);
+    if (ratio != 1.0)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 1\n");
+        goto exit_on_failure;
+    }
+
+    rc = orhash_fini (&hash);
+    free (array);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (shifted_hash != NULL)
+    {
+        orhash_fini (&shifted_hash);
+    }
+    free (shifted);
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+    free (array);
+
+    return EXIT_FAILURE;
+}
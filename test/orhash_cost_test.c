@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+
+#include "orhash.h"
+
+#define NUM_BLOCKS  (16)
+#define BLOCK_SIZE  (4096)
+
+/* Blocks 0-3 are zeros, 4-7 repeat a short pattern, 8-15 are random */
+static void
+_fill (unsigned char *buffer, uint32_t seed)
+{
+    uint32_t    x = seed;
+    int         i;
+
+    memset (buffer, 0, 4 * BLOCK_SIZE);
+
+    for (i = 4 * BLOCK_SIZE; i < 8 * BLOCK_SIZE; i++)
+        buffer[i] = "checkpoint"[i % 10];
+
+    for (i = 8 * BLOCK_SIZE; i < NUM_BLOCKS * BLOCK_SIZE; i++)
+    {
+        x = x * 1103515245U + 12345U;
+        buffer[i] = x >> 24;
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    int             rc;
+    unsigned char   *buffer = NULL;
+    orhash_t        *hash   = NULL;
+    orhash_cost_t   cost;
+    int             i;
+
+    buffer = malloc (NUM_BLOCKS * BLOCK_SIZE);
+    if (buffer == NULL)
+    {
+        fprintf (stderr, "ERROR: malloc() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+    _fill (buffer, 1);
+
+    rc = orhash_init (buffer, NUM_BLOCKS * BLOCK_SIZE, BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_cost_model (hash, 1, 0);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_cost_model() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* One repetitive block and two random blocks are modified */
+    buffer[4 * BLOCK_SIZE] = 'C';
+    for (i = 0; i < BLOCK_SIZE; i++)
+    {
+        buffer[8 * BLOCK_SIZE + i] ^= 0x5a;
+        buffer[12 * BLOCK_SIZE + i] ^= 0xa5;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_checkpoint_cost (hash, &cost);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_checkpoint_cost() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Full checkpoint: %zd bytes (raw: %zd)\n", cost.full_bytes, cost.raw_full_bytes);
+    printf ("*** Incremental checkpoint: %zd bytes (raw: %zd, %zd blocks)\n",
+            cost.incremental_bytes, cost.raw_incremental_bytes, cost.num_dirty);
+
+    if (cost.num_dirty != 3 ||
+        cost.raw_full_bytes != NUM_BLOCKS * BLOCK_SIZE ||
+        cost.raw_incremental_bytes != 3 * BLOCK_SIZE)
+    {
+        fprintf (stderr, "ERROR: wrong number of dirty blocks or raw sizes\n");
+        goto exit_on_failure;
+    }
+
+    /* Zero blocks cost nothing, repetitive blocks little and random blocks
+       almost their size */
+    if (cost.full_bytes > 10 * BLOCK_SIZE || cost.full_bytes < 7 * BLOCK_SIZE)
+    {
+        fprintf (stderr, "ERROR: unexpected full checkpoint size\n");
+        goto exit_on_failure;
+    }
+
+    if (cost.incremental_bytes >= cost.full_bytes ||
+        cost.incremental_bytes < BLOCK_SIZE * 3 / 2)
+    {
+        fprintf (stderr, "ERROR: unexpected incremental checkpoint size\n");
+        goto exit_on_failure;
+    }
+
+    rc = orhash_fini (&hash);
+    free (buffer);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+    free (buffer);
+
+    return EXIT_FAILURE;
+}
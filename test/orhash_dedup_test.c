@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "orhash.h"
+
+#define ARRAY_SIZE  (1024)
+#define BLOCK_SIZE  (8 * sizeof (double))
+
+/* The same analysis on the file, where blocks have to be read back */
+static int
+_check_file (const char *path, int verify)
+{
+    int             rc;
+    orhash_t        *hash   = NULL;
+    orhash_dedup_t  *dedup  = NULL;
+
+    rc = orhash_init_file (path, 0, 0, BLOCK_SIZE, ORHASH_IO_PREAD, 0, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init_file() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_dedup (hash, verify, &dedup);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_dedup() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    printf ("*** File (verify: %d): unique blocks: %zd, duplicates: %zd, zero blocks: %zd\n",
+            verify, dedup->num_unique, dedup->num_duplicates, dedup->num_zero);
+    if (dedup->num_unique != 2 || dedup->num_duplicates != 62 || dedup->num_zero != 64)
+    {
+        fprintf (stderr, "ERROR: expected 2 unique blocks, 62 duplicates and 64 zero blocks\n");
+        goto exit_on_failure;
+    }
+
+    orhash_dedup_fini (&dedup);
+    orhash_fini (&hash);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    orhash_dedup_fini (&dedup);
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
+
+/* Two blocks whose Adler-32 hashes collide are not duplicates, in memory and
+   read back from a file without verification */
+static int
+_check_collision (void)
+{
+    unsigned char   data[2 * BLOCK_SIZE];
+    orhash_t        *hash   = NULL;
+    orhash_dedup_t  *dedup  = NULL;
+    char            path[]  = "orhash_dedup_test.XXXXXX";
+    int             fd;
+    int             mode;
+    size_t          i;
+
+    for (i = 0; i < BLOCK_SIZE; i++)
+    {
+        data[i] = (unsigned char)(i * 3 + 1);
+        data[BLOCK_SIZE + i] = data[i];
+    }
+
+    /* Neither sum of Adler-32 changes */
+    data[BLOCK_SIZE + 10] += 1;
+    data[BLOCK_SIZE + 11] -= 2;
+    data[BLOCK_SIZE + 12] += 1;
+
+    fd = mkstemp (path);
+    if (fd < 0 || write (fd, data, sizeof (data)) != sizeof (data))
+    {
+        fprintf (stderr, "ERROR: cannot create the test file (line: %d)\n", __LINE__);
+        if (fd >= 0)
+            unlink (path);
+        return EXIT_FAILURE;
+    }
+    close (fd);
+
+    for (mode = 0; mode < 2; mode++)
+    {
+        if (mode == 0)
+        {
+            if (orhash_init (data, sizeof (data), BLOCK_SIZE, &hash) != ORHASH_SUCCESS)
+                goto exit_on_failure;
+        } else {
+            if (orhash_init_file (path, 0, 0, BLOCK_SIZE, ORHASH_IO_PREAD, 0, &hash) != ORHASH_SUCCESS)
+                goto exit_on_failure;
+        }
+
+        if (orhash_compute_hash (hash) != ORHASH_SUCCESS ||
+            memcmp (hash->hash[0]->hash, hash->hash[1]->hash, hash->digest_len) != 0)
+        {
+            fprintf (stderr, "ERROR: the block hashes should collide\n");
+            goto exit_on_failure;
+        }
+
+        if (orhash_dedup (hash, 0, &dedup) != ORHASH_SUCCESS)
+        {
+            fprintf (stderr, "ERROR: orhash_dedup() failed (line: %d)\n", __LINE__);
+            goto exit_on_failure;
+        }
+
+        printf ("*** Colliding blocks (%s): unique blocks: %zd\n", mode == 0 ? "memory" : "file",
+                dedup->num_unique);
+        if (dedup->num_unique != 2)
+        {
+            fprintf (stderr, "ERROR: blocks with colliding hashes reported as duplicates\n");
+            goto exit_on_failure;
+        }
+
+        orhash_dedup_fini (&dedup);
+        orhash_fini (&hash);
+    }
+
+    unlink (path);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    unlink (path);
+    orhash_dedup_fini (&dedup);
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
+
+int
+main (int argc, char **argv)
+{
+    int             rc;
+    double          array[ARRAY_SIZE];
+    orhash_t        *hash   = NULL;
+    orhash_dedup_t  *dedup  = NULL;
+    char            path[]  = "orhash_dedup_test.XXXXXX";
+    int             fd      = -1;
+    int             i;
+    double          ratio;
+
+    /* The first half of the array alternates two blocks, the second half is
+       filled with zeros */
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        if (i < ARRAY_SIZE / 2)
+        {
+            array[i] = (i % 16) * 1.0;
+        } else {
+            array[i] = 0.0;
+        }
+    }
+
+    rc = orhash_init (array, ARRAY_SIZE * sizeof (double), BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_dedup (hash, 1, &dedup);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_dedup() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    printf ("*** Unique blocks: %zd, duplicates: %zd, zero blocks: %zd\n",
+            dedup->num_unique, dedup->num_duplicates, dedup->num_zero);
+    if (dedup->num_unique != 2 || dedup->num_duplicates != 62 || dedup->num_zero != 64)
+    {
+        fprintf (stderr, "ERROR: expected 2 unique blocks, 62 duplicates and 64 zero blocks\n");
+        goto exit_on_failure;
+    }
+
+    if (dedup->map[0] != 0 || dedup->map[1] != 1 || dedup->map[2] != 0 ||
+        dedup->map[63] != 1 || dedup->map[64] != ORHASH_DEDUP_ZERO_BLOCK)
+    {
+        fprintf (stderr, "ERROR: wrong duplicate map\n");
+        goto exit_on_failure;
+    }
+
+    rc = orhash_dedup_get_ratio (dedup, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_dedup_get_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dedup ratio: %.3f\n", ratio);
+    if (ratio != 126.0 / 128.0)
+    {
+        fprintf (stderr, "ERROR: the dedup ratio should be equal to 126/128\n");
+        goto exit_on_failure;
+    }
+
+    orhash_dedup_fini (&dedup);
+
+    fd = mkstemp (path);
+    if (fd < 0 || write (fd, array, sizeof (array)) != sizeof (array))
+    {
+        fprintf (stderr, "ERROR: cannot create the test file (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    close (fd);
+
+    if (_check_file (path, 0) != EXIT_SUCCESS || _check_file (path, 1) != EXIT_SUCCESS ||
+        _check_collision () != EXIT_SUCCESS)
+        goto exit_on_failure;
+
+    unlink (path);
+
+    rc = orhash_fini (&hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (fd >= 0)
+        unlink (path);
+    orhash_dedup_fini (&dedup);
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include "orhash.h"
+
+/* Not a multiple of 64 so the last word of the bitmap is partial */
+#define ARRAY_SIZE  (1000)
+
+int
+main (int argc, char **argv)
+{
+    int         rc;
+    double      array[ARRAY_SIZE];
+    uint64_t    bitmap[ORHASH_BITMAP_WORDS (ARRAY_SIZE)];
+    orhash_t    *hash = NULL;
+    size_t      num_dirty;
+    int         i;
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        array[i] = i * 1.0;
+    }
+
+    rc = orhash_init (array, ARRAY_SIZE * sizeof (double), sizeof (double), &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Every third block is modified */
+    for (i = 0; i < ARRAY_SIZE; i += 3)
+    {
+        array[i] = -1.0 - i;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_blocks (hash, bitmap, &num_dirty);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_blocks() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty blocks: %zd\n", num_dirty);
+    if (num_dirty != (ARRAY_SIZE + 2) / 3)
+    {
+        fprintf (stderr, "ERROR: the number of dirty blocks should be %d\n", (ARRAY_SIZE + 2) / 3);
+        goto exit_on_failure;
+    }
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        if (ORHASH_BITMAP_TEST (bitmap, i) != (i % 3 == 0))
+        {
+            fprintf (stderr, "ERROR: wrong bit for block %d\n", i);
+            goto exit_on_failure;
+        }
+    }
+
+    rc = orhash_fini (&hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
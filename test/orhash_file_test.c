@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#define _GNU_SOURCE /* O_DIRECT */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "orhash.h"
+
+/* Spans several reads of ORHASH_FILE_READ_SIZE bytes, the last one partial */
+#define ARRAY_SIZE  ((1 << 18) + 512)
+#define BLOCK_SIZE  (4096)
+
+static int
+_check_file_mode (const char *path, orhash_t *ref, orhash_io_mode_t mode, double *array)
+{
+    int         rc;
+    int         fd;
+    orhash_t    *hash = NULL;
+    double      ratio;
+    double      value = -1.0;
+
+    if (mode == ORHASH_IO_DIRECT)
+    {
+        /* Some file systems, e.g., tmpfs, do not support O_DIRECT */
+        fd = open (path, O_RDONLY | O_DIRECT);
+        if (fd < 0 && errno == EINVAL)
+        {
+            printf ("*** O_DIRECT not available, skipping\n");
+            return EXIT_SUCCESS;
+        }
+        if (fd >= 0)
+            close (fd);
+    }
+
+    rc = orhash_init_file (path, 0, 0, BLOCK_SIZE, mode, 2, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init_file() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_import_ref_hash (hash, ref);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_import_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* The file has the same content as the buffer */
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio (mode %d): %.3f\n", mode, ratio);
+    if (ratio != 0.0)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 0\n");
+        goto exit_on_failure;
+    }
+
+    /* Modify one element in the third block and in the last block of the file */
+    fd = open (path, O_WRONLY);
+    if (fd < 0 || pwrite (fd, &value, sizeof (double), 2 * BLOCK_SIZE + 8) != sizeof (double) ||
+        pwrite (fd, &value, sizeof (double), (ARRAY_SIZE - 1) * sizeof (double)) != sizeof (double))
+    {
+        fprintf (stderr, "ERROR: cannot modify the file (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    fsync (fd);
+    close (fd);
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio (mode %d): %.3f\n", mode, ratio);
+    if (ratio != 2.0 / hash->num_blocks)
+    {
+        fprintf (stderr, "ERROR: only two blocks should be dirty\n");
+        goto exit_on_failure;
+    }
+
+    /* Restore the file for the next mode */
+    fd = open (path, O_WRONLY);
+    if (fd < 0 || pwrite (fd, array, ARRAY_SIZE * sizeof (double), 0) != ARRAY_SIZE * sizeof (double))
+    {
+        fprintf (stderr, "ERROR: cannot restore the file (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    fsync (fd);
+    close (fd);
+
+    orhash_fini (&hash);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
+
+int
+main (int argc, char **argv)
+{
+    int         rc;
+    int         fd      = -1;
+    double      *array  = NULL;
+    orhash_t    *hash   = NULL;
+    char        path[]  = "orhash_file_test.XXXXXX";
+    int         i;
+
+    array = malloc (ARRAY_SIZE * sizeof (double));
+    if (array == NULL)
+    {
+        fprintf (stderr, "ERROR: malloc() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        array[i] = i * 1.0;
+    }
+
+    fd = mkstemp (path);
+    if (fd < 0 || write (fd, array, ARRAY_SIZE * sizeof (double)) != ARRAY_SIZE * sizeof (double))
+    {
+        fprintf (stderr, "ERROR: cannot create the test file (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    fsync (fd);
+    close (fd);
+
+    /* The reference is computed from the buffer in memory */
+    rc = orhash_init (array, ARRAY_SIZE * sizeof (double), BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    if (_check_file_mode (path, hash, ORHASH_IO_MMAP, array) != EXIT_SUCCESS ||
+        _check_file_mode (path, hash, ORHASH_IO_PREAD, array) != EXIT_SUCCESS ||
+        _check_file_mode (path, hash, ORHASH_IO_DIRECT, array) != EXIT_SUCCESS)
+    {
+        goto exit_on_failure;
+    }
+
+    unlink (path);
+
+    rc = orhash_fini (&hash);
+    free (array);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    unlink (path);
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+    free (array);
+
+    return EXIT_FAILURE;
+}
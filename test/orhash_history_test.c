@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <math.h>
+
+#include "orhash.h"
+
+#define NUM_BLOCKS  (1024)
+#define NUM_STEPS   (8)
+#define NUM_WRITES  (64)    /* Random writes per step, in the first half */
+
+int
+main (int argc, char **argv)
+{
+    int                     rc;
+    double                  array[NUM_BLOCKS];
+    orhash_t                *hash       = NULL;
+    orhash_history_t        *history    = NULL;
+    orhash_ckpt_params_t    params;
+    uint32_t                x           = 1;
+    double                  ratio;
+    double                  predicted;
+    double                  interval;
+    double                  young;
+    int                     step;
+    int                     i;
+
+    for (i = 0; i < NUM_BLOCKS; i++)
+    {
+        array[i] = i * 1.0;
+    }
+
+    rc = orhash_init (array, NUM_BLOCKS * sizeof (double), sizeof (double), &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Fewer slots than steps so that the ring wraps around */
+    rc = orhash_history_init (hash, NUM_STEPS - 2, 2, &history);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_history_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Only the first half of the array is ever written */
+    for (step = 1; step <= NUM_STEPS; step++)
+    {
+        for (i = 0; i < NUM_WRITES; i++)
+        {
+            x = x * 1103515245U + 12345U;
+            array[(x >> 16) % (NUM_BLOCKS / 2)] += 1.0;
+        }
+
+        rc = orhash_compute_hash (hash);
+        if (rc != ORHASH_SUCCESS)
+        {
+            fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+            goto exit_on_failure;
+        }
+
+        rc = orhash_history_record (history, step);
+        if (rc != ORHASH_SUCCESS)
+        {
+            fprintf (stderr, "ERROR: orhash_history_record() failed (line: %d)\n", __LINE__);
+            goto exit_on_failure;
+        }
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_history_fit (history);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_history_fit() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty rates: %f %f\n", history->region_rates[0], history->region_rates[1]);
+
+    if (history->num_samples != NUM_STEPS - 2 || history->region_rates[1] != 0.0)
+    {
+        fprintf (stderr, "ERROR: the untouched region should have no dirty rate\n");
+        goto exit_on_failure;
+    }
+
+    rc = orhash_history_predict (history, NUM_STEPS, &predicted);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_history_predict() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio: %.3f (predicted: %.3f)\n", ratio, predicted);
+
+    if (fabs (predicted - ratio) > 0.05)
+    {
+        fprintf (stderr, "ERROR: the prediction does not match the last sample\n");
+        goto exit_on_failure;
+    }
+
+    /* The working set is half of the array */
+    rc = orhash_history_predict (history, 1000.0 * NUM_STEPS, &predicted);
+    if (rc != ORHASH_SUCCESS || fabs (predicted - 0.5) > 1e-3)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should saturate at 0.5\n");
+        goto exit_on_failure;
+    }
+
+    /* One step of application writes costs as much as writing the full array */
+    params.write_bandwidth  = NUM_BLOCKS * sizeof (double);
+    params.failure_rate     = 1.0 / 1000.0;
+    params.latency          = 0.1;
+
+    rc = orhash_history_suggest_interval (history, &params, &interval, &predicted);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_history_suggest_interval() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    young = sqrt (2.0 * (params.latency + 1.0) / params.failure_rate);
+    printf ("*** Checkpoint interval: %.2f (dirty ratio: %.3f, full checkpoints: %.2f)\n",
+            interval, predicted, young);
+
+    if (interval <= sqrt (2.0 * params.latency / params.failure_rate) || interval >= young)
+    {
+        fprintf (stderr, "ERROR: the interval should be shorter than for full checkpoints\n");
+        goto exit_on_failure;
+    }
+
+    orhash_history_fini (&history);
+    rc = orhash_fini (&hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    orhash_history_fini (&history);
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
@@ -8,6 +8,81 @@
 
 #define ARRAY_SIZE  (10)
 
+/* Grow a hash of 8 blocks to 10 blocks, the new ones at the end or at the
+   front of the buffer; only the new blocks are dirty */
+static int
+_check_growth (long block_offset)
+{
+    int         rc;
+    double      array[ARRAY_SIZE];
+    orhash_t    *hash = NULL;
+    size_t      num_dirty;
+    uint64_t    bitmap[ORHASH_BITMAP_WORDS (ARRAY_SIZE)];
+    int         first_new;
+    int         i;
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        array[i] = i * 1.0;
+    }
+
+    rc = orhash_init (array, 8 * sizeof (double), sizeof (double), &hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_compute_hash (hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: cannot hash the reference (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* New blocks at the front shift the old ones */
+    if (block_offset < 0)
+    {
+        for (i = ARRAY_SIZE - 1; i >= 2; i--)
+        {
+            array[i] = (i - 2) * 1.0;
+        }
+        array[0] = 32.0;
+        array[1] = 42.0;
+    }
+
+    rc = orhash_reinit (hash, array, ARRAY_SIZE * sizeof (double), block_offset);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_compute_hash (hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_get_dirty_blocks (hash, bitmap, &num_dirty);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: cannot grow the hash (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    printf ("*** Dirty blocks after growing by %ld: %zd of %zd\n", block_offset, num_dirty, hash->num_blocks);
+    first_new = block_offset < 0 ? 0 : 8;
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        if (ORHASH_BITMAP_TEST (bitmap, i) != (i >= first_new && i < first_new + 2))
+        {
+            fprintf (stderr, "ERROR: block %d is wrongly reported after the growth\n", i);
+            goto exit_on_failure;
+        }
+    }
+
+    orhash_fini (&hash);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -16,6 +91,8 @@ main (int argc, char **argv)
     orhash_t    *hash = NULL;
     int         i;
     double      ratio;
+    size_t      num_dirty;
+    uint64_t    bitmap[ORHASH_BITMAP_WORDS (ARRAY_SIZE)];
 
     for (i = 0; i < ARRAY_SIZE; i++)
     {
@@ -62,6 +139,37 @@ main (int argc, char **argv)
 
     orhash_print (hash);
 
+    /* The old blocks 0 to 7 are now the blocks 2 to 9: only the two new
+       blocks at the front are dirty */
+    for (i = ARRAY_SIZE - 1; i >= 2; i--)
+    {
+        array[i] = (i - 2) * 1.0;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_blocks (hash, bitmap, &num_dirty);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_blocks() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    printf ("*** Dirty blocks after the shift: %zd\n", num_dirty);
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        if (ORHASH_BITMAP_TEST (bitmap, i) != (i < 2))
+        {
+            fprintf (stderr, "ERROR: block %d is wrongly reported %s\n", i, i < 2 ? "clean" : "dirty");
+            goto exit_on_failure;
+        }
+    }
+
     rc = orhash_fini (&hash);
     if (rc != ORHASH_SUCCESS)
     {
@@ -69,6 +177,9 @@ main (int argc, char **argv)
         return EXIT_FAILURE;
     }
 
+    if (_check_growth (2) != EXIT_SUCCESS || _check_growth (-2) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
     return EXIT_SUCCESS;
 
  exit_on_failure:
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "orhash.h"
+
+/* More than 2^32 blocks of one byte, in a reservation that is barely used */
+#define BUFFER_SIZE ((1UL << 32) + (1UL << 20))
+#define GiB         (1UL << 30)
+
+static int
+_write_and_touch (orhash_t *hash, char *buffer, size_t offset, const char *data, size_t len)
+{
+    memcpy (buffer + offset, data, len);
+
+    return orhash_sparse_touch (hash, offset, len);
+}
+
+int
+main (int argc, char **argv)
+{
+    int         rc;
+    char        *buffer;
+    orhash_t    *hash   = NULL;
+    size_t      num_dirty;
+
+    buffer = mmap (NULL, BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (buffer == MAP_FAILED)
+    {
+        fprintf (stderr, "ERROR: mmap() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    rc = orhash_init_sparse (buffer, BUFFER_SIZE, 1, 0, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init_sparse() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    if (hash->num_blocks != BUFFER_SIZE)
+    {
+        fprintf (stderr, "ERROR: the number of blocks is truncated (%zd)\n", hash->num_blocks);
+        goto exit_on_failure;
+    }
+
+    rc = _write_and_touch (hash, buffer, 10, "orhash!", 8);
+    if (rc == ORHASH_SUCCESS)
+        rc = _write_and_touch (hash, buffer, 3 * GiB + 5, "sparse!", 8);
+    if (rc == ORHASH_SUCCESS)
+        rc = _write_and_touch (hash, buffer, 4 * GiB + 100, "64 bits", 8);
+    /* Touched but left to zeros */
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_sparse_touch (hash, 2 * GiB, 4096);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_sparse_touch() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Regions with storage: %zd / %zd\n", hash->num_sparse_allocated, hash->num_sparse_regions);
+
+    if (hash->num_sparse_allocated != 3)
+    {
+        fprintf (stderr, "ERROR: only the regions with data should have storage\n");
+        goto exit_on_failure;
+    }
+
+    /* One byte above 4 GiB changes and the first region goes back to zeros */
+    buffer[4 * GiB + 101] = 'X';
+    rc = orhash_sparse_touch (hash, 4 * GiB + 101, 1);
+    if (rc == ORHASH_SUCCESS)
+        rc = _write_and_touch (hash, buffer, 10, "\0\0\0\0\0\0\0\0", 8);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_sparse_touch() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_blocks (hash, NULL, &num_dirty);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_blocks() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty blocks: %zd\n", num_dirty);
+
+    /* The 7 bytes of "orhash!" and the changed byte */
+    if (num_dirty != 8)
+    {
+        fprintf (stderr, "ERROR: the number of dirty blocks should be 8\n");
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS || hash->num_sparse_allocated != 2)
+    {
+        fprintf (stderr, "ERROR: the storage of the region back to zeros should be released\n");
+        goto exit_on_failure;
+    }
+
+    rc = orhash_fini (&hash);
+    munmap (buffer, BUFFER_SIZE);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+    munmap (buffer, BUFFER_SIZE);
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "orhash.h"
+
+/* A co-runner walks a working set that fits in the last level cache while
+   the buffer is hashed, with and without streaming. The slowdown of the
+   co-runner measures how much of the caches the hashing takes from it. */
+
+#define BUFFER_SIZE         (256UL << 20)
+#define BLOCK_SIZE          (4096)
+#define WORKING_SET_SIZE    (4UL << 20)
+#define RUN_SECONDS         (2.0)
+#define CHASE_STEPS         (1 << 16)
+
+typedef struct corunner_s {
+    size_t          *chain;     /* Random cycle over the cache lines of the working set */
+    volatile int    stop;
+    double          ns_per_access;
+} corunner_t;
+
+static double
+_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *
+_corunner (void *arg)
+{
+    corunner_t  *c = arg;
+    size_t      idx = 0;
+    size_t      n = 0;
+    double      start;
+    int         i;
+
+    start = _now ();
+    while (!c->stop)
+    {
+        for (i = 0; i < CHASE_STEPS; i++)
+            idx = c->chain[idx];
+        n += CHASE_STEPS;
+    }
+
+    /* Keep the walk from being optimized out */
+    if (idx == (size_t)-1)
+        printf ("\n");
+
+    c->ns_per_access = (_now () - start) * 1e9 / n;
+
+    return NULL;
+}
+
+static int
+_init_chain (corunner_t *c)
+{
+    size_t  stride = ORHASH_CACHE_LINE_SIZE / sizeof (size_t);
+    size_t  n = WORKING_SET_SIZE / ORHASH_CACHE_LINE_SIZE;
+    size_t  *order;
+    size_t  i;
+    size_t  j;
+    size_t  t;
+
+    c->chain = malloc (WORKING_SET_SIZE);
+    order = malloc (n * sizeof (size_t));
+    if (c->chain == NULL || order == NULL)
+    {
+        free (order);
+        return ORHASH_ERROR;
+    }
+
+    /* One entry per cache line, visited in a random order to defeat the
+       hardware prefetchers */
+    for (i = 0; i < n; i++)
+        order[i] = i;
+    srand (42);
+    for (i = n - 1; i > 0; i--)
+    {
+        j = (size_t)rand () % (i + 1);
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (i = 0; i < n; i++)
+        c->chain[order[i] * stride] = order[(i + 1) % n] * stride;
+
+    free (order);
+
+    return ORHASH_SUCCESS;
+}
+
+/* Run the co-runner for RUN_SECONDS, while the buffer is hashed if hash is
+   not NULL; returns the co-runner time per access and the hashing bandwidth */
+static int
+_run (corunner_t *c, orhash_t *hash, double *ns_per_access, double *gib_per_s)
+{
+    pthread_t   thread;
+    double      start;
+    double      elapsed;
+    size_t      n = 0;
+    int         rc = ORHASH_SUCCESS;
+
+    c->stop = 0;
+    if (pthread_create (&thread, NULL, _corunner, c) != 0)
+        return ORHASH_ERROR;
+
+    start = _now ();
+    do {
+        if (hash != NULL)
+        {
+            rc = orhash_compute_hash (hash);
+            if (rc != ORHASH_SUCCESS)
+                break;
+            n++;
+        } else {
+            struct timespec ts = { 0, 10000000 };
+            nanosleep (&ts, NULL);
+        }
+    } while (_now () - start < RUN_SECONDS);
+
+    elapsed = _now () - start;
+    c->stop = 1;
+    pthread_join (thread, NULL);
+
+    *ns_per_access = c->ns_per_access;
+    *gib_per_s = n * (double)BUFFER_SIZE / elapsed / (1UL << 30);
+
+    return rc;
+}
+
+int
+main (int argc, char **argv)
+{
+    int         rc;
+    char        *buffer = NULL;
+    orhash_t    *hash   = NULL;
+    corunner_t  c       = { NULL, 0, 0.0 };
+    double      alone;
+    double      ns;
+    double      bw;
+    size_t      i;
+    int         mode;
+    size_t      distances[] = { 256, 1024, 4096 };
+
+    buffer = malloc (BUFFER_SIZE);
+    if (buffer == NULL || _init_chain (&c) != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: malloc() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    for (i = 0; i < BUFFER_SIZE; i++)
+        buffer[i] = (char)i;
+
+    rc = orhash_init (buffer, BUFFER_SIZE, BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    printf ("Co-runner working set: %lu KiB, hashed buffer: %lu MiB\n",
+            WORKING_SET_SIZE >> 10, BUFFER_SIZE >> 20);
+    /* On a single core the co-runner is slowed down by time sharing, which
+       hides the effect of the caches */
+    if (sysconf (_SC_NPROCESSORS_ONLN) < 2)
+        printf ("WARNING: a single CPU is online, the slowdowns are not meaningful\n");
+
+    rc = _run (&c, NULL, &alone, &bw);
+    if (rc != ORHASH_SUCCESS)
+        goto exit_on_failure;
+    printf ("%-24s co-runner %6.2f ns/access\n", "alone", alone);
+
+    for (mode = -1; mode < (int)(sizeof (distances) / sizeof (distances[0])); mode++)
+    {
+        char label[64];
+
+        if (mode < 0)
+        {
+            rc = orhash_set_streaming (hash, 0, 0);
+            snprintf (label, sizeof (label), "hashing");
+        } else {
+            rc = orhash_set_streaming (hash, 1, distances[mode]);
+            snprintf (label, sizeof (label), "streaming, %zd B ahead", distances[mode]);
+        }
+        if (rc != ORHASH_SUCCESS)
+        {
+            fprintf (stderr, "ERROR: orhash_set_streaming() failed (line: %d)\n", __LINE__);
+            goto exit_on_failure;
+        }
+
+        rc = _run (&c, hash, &ns, &bw);
+        if (rc != ORHASH_SUCCESS)
+        {
+            fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+            goto exit_on_failure;
+        }
+
+        printf ("%-24s co-runner %6.2f ns/access (slowdown %.2fx), hashing %.2f GiB/s\n",
+                label, ns, ns / alone, bw);
+    }
+
+    orhash_fini (&hash);
+    free (c.chain);
+    free (buffer);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+    free (c.chain);
+    free (buffer);
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include "orhash.h"
+
+#define ARRAY_SIZE  (1 << 20)
+#define BLOCK_SIZE  (4096)
+
+int
+main (int argc, char **argv)
+{
+    int         rc;
+    double      *array  = NULL;
+    orhash_t    *hash   = NULL;
+    int         i;
+    double      ratio;
+
+    array = malloc (ARRAY_SIZE * sizeof (double));
+    if (array == NULL)
+    {
+        fprintf (stderr, "ERROR: malloc() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        array[i] = i * 1.0;
+    }
+
+    rc = orhash_init (array, ARRAY_SIZE * sizeof (double), BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* The reference is computed without streaming */
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_streaming (hash, 1, 2000);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_streaming() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    for (i = 0; i < ARRAY_SIZE / 2; i++)
+    {
+        array[i] = i * 2.0;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio: %.3f\n", ratio);
+
+    if (ratio != 0.5)
+    {
+        fprintf (stderr, "ERROR: the hashes computed in streaming mode differ\n");
+        goto exit_on_failure;
+    }
+
+    rc = orhash_fini (&hash);
+    free (array);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_fini() failed (line: %d)\n", __LINE__);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+    free (array);
+
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+
+#include "orhash.h"
+
+#define BUFFER_SIZE (256)
+#define BLOCK_SIZE  (64)
+
+static int
+_compute_dirty_ratio (int use_strong_hash, double *ratio, size_t *collisions)
+{
+    int             rc;
+    unsigned char   buffer[BUFFER_SIZE];
+    orhash_t        *hash = NULL;
+
+    memset (buffer, 10, BUFFER_SIZE);
+
+    rc = orhash_init (buffer, BUFFER_SIZE, BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    if (use_strong_hash)
+    {
+        rc = orhash_set_strong_hash (hash, MHASH_MD5);
+        if (rc != ORHASH_SUCCESS)
+        {
+            fprintf (stderr, "ERROR: orhash_set_strong_hash() failed (line: %d)\n", __LINE__);
+            goto exit_on_failure;
+        }
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Adding 1, -2 and 1 to three consecutive bytes does not change the
+       Adler-32 checksum of the block */
+    buffer[BLOCK_SIZE + 0] += 1;
+    buffer[BLOCK_SIZE + 1] -= 2;
+    buffer[BLOCK_SIZE + 2] += 1;
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    *collisions = hash->num_weak_collisions;
+    printf ("*** Dirty ratio (strong hash: %d): %.3f\n", use_strong_hash, *ratio);
+
+    orhash_fini (&hash);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
+
+int
+main (int argc, char **argv)
+{
+    double  ratio;
+    size_t  collisions;
+
+    /* The fast hash alone misses the modification */
+    if (_compute_dirty_ratio (0, &ratio, &collisions) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (ratio != 0.0)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 0\n");
+        return EXIT_FAILURE;
+    }
+
+    if (_compute_dirty_ratio (1, &ratio, &collisions) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (ratio != 0.25 || collisions != 1)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 0.25 with one collision\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <string.h>
+
+#include "orhash.h"
+
+#define ARRAY_SIZE  (1024)
+#define BLOCK_SIZE  (8 * sizeof (double))
+
+/* Flip the least significant bit of the mantissa, i.e., round-off noise */
+static double
+_add_noise (double d)
+{
+    uint64_t bits;
+
+    memcpy (&bits, &d, sizeof (bits));
+    bits ^= 1;
+    memcpy (&d, &bits, sizeof (bits));
+
+    return d;
+}
+
+static int
+_compute_dirty_ratio (orhash_tol_mode_t mode, double tolerance, double *ratio)
+{
+    int         rc;
+    double      array[ARRAY_SIZE];
+    orhash_t    *hash = NULL;
+    int         i;
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        /* Values in the middle of the buckets of the absolute tolerance */
+        array[i] = i + 0.0005;
+    }
+
+    rc = orhash_init (array, ARRAY_SIZE * sizeof (double), BLOCK_SIZE, &hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_init() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_tolerance (hash, ORHASH_TYPE_DOUBLE, mode, tolerance);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_tolerance() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_set_ref_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Noise everywhere, a real change in the first quarter of the array */
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        array[i] = _add_noise (array[i]);
+        if (i < ARRAY_SIZE / 4)
+            array[i] += 1.0;
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_compute_hash() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    rc = orhash_get_dirty_ratio (hash, ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: orhash_get_dirty_ratio() failed (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+    printf ("*** Dirty ratio (tolerance mode %d): %.3f\n", mode, *ratio);
+
+    orhash_fini (&hash);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
+
+/* Value of element i of the array of the given type, with noise added and,
+   for changed elements, a change above the tolerance; values are negative
+   in the first half of the array */
+static void
+_set_elem (void *array, orhash_elem_type_t type, int i, int noise, int changed)
+{
+    long v = i - ARRAY_SIZE / 2;
+
+    switch (type)
+    {
+        case ORHASH_TYPE_FLOAT:
+            /* Tolerance of 1.0 */
+            ((float*)array)[i] = v + 0.25f + noise * 0.25f + changed;
+            break;
+        case ORHASH_TYPE_INT32:
+            /* Tolerance of 4 */
+            ((int32_t*)array)[i] = (int32_t)(4 * v + 1 + noise + 4 * changed);
+            break;
+        case ORHASH_TYPE_INT64:
+            /* Tolerances of 3 and 4 */
+            ((int64_t*)array)[i] = 12 * v + 1 + noise + 12 * changed;
+            break;
+        default:
+            break;
+    }
+}
+
+static int
+_check_type (orhash_elem_type_t type, orhash_tol_mode_t mode, double tolerance, size_t elem_size)
+{
+    int         rc;
+    int64_t     array[ARRAY_SIZE];
+    orhash_t    *hash = NULL;
+    double      ratio;
+    int         i;
+
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        _set_elem (array, type, i, 0, 0);
+    }
+
+    rc = orhash_init (array, ARRAY_SIZE * elem_size, BLOCK_SIZE, &hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_set_tolerance (hash, type, mode, tolerance);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_compute_hash (hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_set_ref_hash (hash);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: cannot hash the reference (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    /* Noise everywhere, a real change in the first quarter of the array */
+    for (i = 0; i < ARRAY_SIZE; i++)
+    {
+        _set_elem (array, type, i, 1, i < ARRAY_SIZE / 4);
+    }
+
+    rc = orhash_compute_hash (hash);
+    if (rc == ORHASH_SUCCESS)
+        rc = orhash_get_dirty_ratio (hash, &ratio);
+    if (rc != ORHASH_SUCCESS)
+    {
+        fprintf (stderr, "ERROR: cannot get the dirty ratio (line: %d)\n", __LINE__);
+        goto exit_on_failure;
+    }
+
+    printf ("*** Dirty ratio (type %d, tolerance %g): %.3f\n", type, tolerance, ratio);
+    if (ratio != 0.25)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 0.25\n");
+        goto exit_on_failure;
+    }
+
+    orhash_fini (&hash);
+
+    return EXIT_SUCCESS;
+
+ exit_on_failure:
+    if (hash != NULL)
+    {
+        orhash_fini (&hash);
+    }
+
+    return EXIT_FAILURE;
+}
+
+int
+main (int argc, char **argv)
+{
+    double ratio;
+
+    /* Without tolerance the noise makes blocks dirty beyond the real change */
+    if (_compute_dirty_ratio (ORHASH_TOL_NONE, 0.0, &ratio) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (ratio <= 0.25)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be greater than 0.25\n");
+        return EXIT_FAILURE;
+    }
+
+    if (_compute_dirty_ratio (ORHASH_TOL_RELATIVE, 1e-6, &ratio) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (ratio != 0.25)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 0.25\n");
+        return EXIT_FAILURE;
+    }
+
+    if (_compute_dirty_ratio (ORHASH_TOL_ABSOLUTE, 1e-3, &ratio) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    if (ratio != 0.25)
+    {
+        fprintf (stderr, "ERROR: the dirty ratio should be equal to 0.25\n");
+        return EXIT_FAILURE;
+    }
+
+    if (_check_type (ORHASH_TYPE_FLOAT, ORHASH_TOL_ABSOLUTE, 1.0, sizeof (float)) != EXIT_SUCCESS ||
+        _check_type (ORHASH_TYPE_INT32, ORHASH_TOL_ABSOLUTE, 4.0, sizeof (int32_t)) != EXIT_SUCCESS ||
+        _check_type (ORHASH_TYPE_INT64, ORHASH_TOL_ABSOLUTE, 4.0, sizeof (int64_t)) != EXIT_SUCCESS ||
+        _check_type (ORHASH_TYPE_INT64, ORHASH_TOL_ABSOLUTE, 3.0, sizeof (int64_t)) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2016      UT-Battelle, LLC
+ *                         All rights reserved.
+ *
+ */
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "orhash.hpp"
+
+#define ARRAY_SIZE  (10000)     /* The last block is a partial block */
+#define BLOCK_SIZE  (4096)
+
+int
+main (int argc, char **argv)
+{
+    using tracker_t = orhash::tracker<double, BLOCK_SIZE>;
+
+    std::vector<double>         array (ARRAY_SIZE);
+    const std::vector<double>   &const_array = array;
+    std::array<double, 1024>    small;
+    std::array<unsigned char, tracker_t::storage_bytes_for (ARRAY_SIZE)> digests;
+    std::array<unsigned char, tracker_t::storage_bytes_for (ARRAY_SIZE)> ref_digests;
+
+    static_assert (tracker_t::num_blocks_for (ARRAY_SIZE) == (ARRAY_SIZE * sizeof (double) + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                   "wrong number of blocks");
+
+    for (int i = 0; i < ARRAY_SIZE; i++)
+    {
+        array[i] = i * 1.0;
+    }
+    small.fill (1.0);
+
+    try
+    {
+        /* Read-only views of the data are enough to track it */
+        orhash::hash    hash (const_array, BLOCK_SIZE);
+        tracker_t       tracker (const_array);
+        tracker_t       static_tracker (array.data (), array.size (), digests.data (), ref_digests.data ());
+        orhash::tracker<double, 1024> small_tracker (small);
+
+        hash.compute ();
+        hash.set_reference ();
+        tracker.compute ();
+        tracker.set_reference ();
+        static_tracker.compute ();
+        static_tracker.set_reference ();
+        small_tracker.compute ();
+        small_tracker.set_reference ();
+
+        for (int i = 0; i < ARRAY_SIZE / 2; i++)
+        {
+            array[i] = i * 2.0;
+        }
+        array[ARRAY_SIZE - 1] = -1.0;
+        small[0] = 2.0;
+
+        /* A moved tracker keeps tracking the same array */
+        tracker_t moved (std::move (tracker));
+
+        hash.compute ();
+        moved.compute ();
+        static_tracker.compute ();
+        small_tracker.compute ();
+
+        printf ("*** Dirty ratio: %.3f (C core), %.3f (tracker), %.3f (caller storage)\n",
+                hash.dirty_ratio (), moved.dirty_ratio (), static_tracker.dirty_ratio ());
+
+        if (hash.num_blocks () != moved.num_blocks () ||
+            hash.dirty_blocks () != moved.dirty_blocks () ||
+            hash.dirty_blocks () != static_tracker.dirty_blocks ())
+        {
+            fprintf (stderr, "ERROR: the C core and the trackers do not agree\n");
+            return EXIT_FAILURE;
+        }
+
+        /* The compile-time kernel computes the same bytes as the C core */
+        if (memcmp (hash.get ()->digests, moved.get ()->digests, digests.size ()) != 0 ||
+            memcmp (hash.get ()->digests, digests.data (), digests.size ()) != 0)
+        {
+            fprintf (stderr, "ERROR: the trackers and the C core compute different hashes\n");
+            return EXIT_FAILURE;
+        }
+
+        if (small_tracker.num_blocks () != 8 || small_tracker.dirty_blocks () != 1)
+        {
+            fprintf (stderr, "ERROR: only the first block of the small array should be dirty\n");
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const orhash::error &e)
+    {
+        fprintf (stderr, "ERROR: %s\n", e.what ());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}